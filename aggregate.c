@@ -0,0 +1,176 @@
+// C imports
+#include <math.h>
+
+// C++ imports
+#include <vector>
+#include <algorithm>
+
+// Module imports
+#include "aggregate.h"
+
+void agg::Running::add(double x)
+{
+	n += 1.0;
+	double d = x - mean;
+	mean += d / n;
+	m2 += d * (x - mean);
+}
+
+void agg::Running::remove(double x)
+{
+	if(n <= 1.0) { *this = Running(); return; }
+	double d = x - mean;
+	mean -= d / (n - 1.0);
+	m2 -= d * (x - mean);
+	m2 = m2 < 0.0 ? 0.0 : m2;
+	n -= 1.0;
+}
+
+double agg::Running::variance() const { return n > 0.0 ? m2 / n : 0.0; }
+
+agg::Running agg::merge(const Running& a, const Running& b, double shift)
+{
+	// Chan's pairwise update
+	if(b.n == 0.0) { return a; }
+	Running ret;
+	ret.n = a.n + b.n;
+	double d = (b.mean + shift) - a.mean;
+	ret.mean = a.mean + d * b.n / ret.n;
+	ret.m2 = a.m2 + b.m2 + d * d * a.n * b.n / ret.n;
+	return ret;
+}
+
+void agg::Tally::set(uint64_t uid, uint32_t layer, double v, bool mark)
+{
+	erase(uid);
+	value[uid] = {layer, v};
+	run[layer].add(v);
+	sorted[layer].insert(v);
+	if(mark) { fresh.insert(uid); }
+}
+
+void agg::Tally::erase(uint64_t uid)
+{
+	auto found = value.find(uid);
+	if(found == value.end()) { return; }
+	auto [layer, v] = found->second;
+	run[layer].remove(v);
+	auto& s = sorted[layer];
+	s.erase(s.find(v));
+	// Empty layers are dropped so the top layer stays right
+	if(s.size() == 0) { run.erase(layer); sorted.erase(layer); }
+	value.erase(found);
+	fresh.erase(uid);
+}
+
+bool agg::Tally::has(uint64_t uid) const { return value.count(uid) > 0; }
+
+double agg::Tally::get(uint64_t uid) const
+{
+	auto found = value.find(uid);
+	return found == value.end() ? 0.0 : found->second.second;
+}
+
+uint32_t agg::Tally::top() const
+{
+	return run.size() == 0 ? 0 : run.rbegin()->first;
+}
+
+agg::Summary agg::Tally::total(std::function<double(uint32_t)> offset) const
+{
+	Running all;
+	double min = INFINITY;
+	double max = -INFINITY;
+	for(auto & [layer,r] : run)
+	{
+		double o = offset(layer);
+		all = merge(all, r, o);
+		const auto& s = sorted.at(layer);
+		min = std::min(min, *s.begin() + o);
+		max = std::max(max, *s.rbegin() + o);
+	}
+	if(all.n == 0.0) { return {0.0, 0.0, 0.0, 0.0, 0.0}; }
+	return {all.n, all.mean, all.variance(), min, max};
+}
+
+std::vector<uint64_t> agg::Tally::take()
+{
+	std::vector<uint64_t> ret(fresh.begin(), fresh.end());
+	fresh.clear();
+	return ret;
+}
+
+bool agg::Ranking::above(uint32_t a, uint32_t b) const
+{
+	if(heap[a].key != heap[b].key) { return heap[a].key > heap[b].key; }
+	return heap[a].uid < heap[b].uid;
+}
+
+void agg::Ranking::swap(uint32_t a, uint32_t b)
+{
+	std::swap(heap[a], heap[b]);
+	place[heap[a].uid] = a;
+	place[heap[b].uid] = b;
+}
+
+void agg::Ranking::up(uint32_t i)
+{
+	while(i > 0 && above(i, (i - 1) / 2))
+	{
+		swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+void agg::Ranking::down(uint32_t i)
+{
+	while(true)
+	{
+		uint32_t best = i;
+		uint32_t l = 2 * i + 1;
+		uint32_t r = 2 * i + 2;
+		if(l < heap.size() && above(l, best)) { best = l; }
+		if(r < heap.size() && above(r, best)) { best = r; }
+		if(best == i) { return; }
+		swap(i, best);
+		i = best;
+	}
+}
+
+void agg::Ranking::set(uint64_t uid, double key, uint32_t value)
+{
+	auto found = place.find(uid);
+	if(found == place.end())
+	{
+		heap.push_back({key, uid, value});
+		place[uid] = heap.size() - 1;
+		up(heap.size() - 1);
+		return;
+	}
+	uint32_t i = found->second;
+	heap[i] = {key, uid, value};
+	up(i);
+	down(place[uid]);
+}
+
+void agg::Ranking::erase(uint64_t uid)
+{
+	auto found = place.find(uid);
+	if(found == place.end()) { return; }
+	uint32_t i = found->second;
+	uint32_t last = heap.size() - 1;
+	// Move the last entry into the hole, then settle it either way
+	if(i != last) { swap(i, last); }
+	heap.pop_back();
+	place.erase(uid);
+	if(i < heap.size()) { up(i); down(place[heap[i].uid]); }
+}
+
+bool agg::Ranking::has(uint64_t uid) const { return place.count(uid) > 0; }
+
+const agg::Ranked* agg::Ranking::top() const
+{
+	return heap.size() == 0 ? NULL : &heap[0];
+}
+
+uint32_t agg::Ranking::size() const { return heap.size(); }
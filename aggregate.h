@@ -0,0 +1,96 @@
+// C++ imports
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <functional>
+
+#ifndef aggregate_h
+#define aggregate_h
+namespace agg
+{
+	// A running count, mean and sum of squared deviations, updated one value
+	// at a time (Welford). Values can also be taken back out and runs merged,
+	// so the statistics of a changing set never need a rescan.
+	typedef struct running
+	{
+		double n = 0.0;
+		double mean = 0.0;
+		double m2 = 0.0;
+		void add(double x);
+		void remove(double x);
+		double variance() const;
+	} Running;
+	// Two runs as one, with every value of the second moved by shift
+	Running merge(const Running& a, const Running& b, double shift = 0.0);
+
+	typedef struct summary
+	{
+		double n;
+		double mean;
+		double variance;
+		double min;
+		double max;
+	} Summary;
+
+	// A value for each of a changing set of segments by uid, with running
+	// statistics per layer. Setting or erasing one value is O(log n).
+	class Tally
+	{
+		std::unordered_map<uint64_t,std::pair<uint32_t,double>> value;
+		std::map<uint32_t,Running> run;
+		std::map<uint32_t,std::multiset<double>> sorted;
+		// Uids set since they were last taken
+		std::set<uint64_t> fresh;
+		public:
+			// How far a change journal has been read, and whether the tally
+			// has been filled from the whole set yet
+			uint64_t cursor = 0;
+			bool primed = false;
+			// Journal positions from, up to to, that the owner made itself
+			uint64_t ownFrom = 0;
+			uint64_t ownTo = 0;
+			void set(uint64_t uid, uint32_t layer, double v, bool mark = true);
+			void erase(uint64_t uid);
+			bool has(uint64_t uid) const;
+			double get(uint64_t uid) const;
+			// The highest layer holding a value
+			uint32_t top() const;
+			// Over all layers, with the values of each moved by offset(layer)
+			Summary total(std::function<double(uint32_t)> offset) const;
+			// The uids set since the last take
+			std::vector<uint64_t> take();
+	};
+
+	typedef struct ranked
+	{
+		double key;
+		uint64_t uid;
+		uint32_t value;
+	} Ranked;
+
+	// The largest of a changing set of keys by uid, as a binary heap that
+	// knows where each uid sits. Setting, erasing or taking the top is
+	// O(log n), ties go to the lower uid.
+	class Ranking
+	{
+		std::vector<Ranked> heap;
+		std::unordered_map<uint64_t,uint32_t> place;
+		bool above(uint32_t a, uint32_t b) const;
+		void swap(uint32_t a, uint32_t b);
+		void up(uint32_t i);
+		void down(uint32_t i);
+		public:
+			// How far a change journal has been read, as for a tally
+			uint64_t cursor = 0;
+			bool primed = false;
+			void set(uint64_t uid, double key, uint32_t value);
+			void erase(uint64_t uid);
+			bool has(uint64_t uid) const;
+			// The largest key, NULL when empty
+			const Ranked* top() const;
+			uint32_t size() const;
+	};
+};
+#endif
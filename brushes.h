@@ -3,11 +3,16 @@
 
 #ifndef brushes_h
 #define brushes_h
-Callback solid(Workspace*, Segment, Brush);
-Callback shape(Workspace*, Segment, Brush);
-Callback line(Workspace*, Segment, Brush);
-Callback shade(Workspace*, Segment, Brush);
-Callback specularhighlight(Workspace*, Segment, Brush);
+// Each brush scores a segment cheaply, and prepares its drawing when chosen
+Score solid_score(Workspace*, const Segment&, const Brush&);
+Score shape_score(Workspace*, const Segment&, const Brush&);
+Score line_score(Workspace*, const Segment&, const Brush&);
+Score specularhighlight_score(Workspace*, const Segment&, const Brush&);
+std::function<void()> solid(Workspace*, const Segment&, const Brush&);
+std::function<void()> shape(Workspace*, const Segment&, const Brush&);
+std::function<void()> line(Workspace*, const Segment&, const Brush&);
+std::function<void()> shade(Workspace*, const Segment&, const Brush&);
+std::function<void()> specularhighlight(Workspace*, const Segment&, const Brush&);
 
 static Brush shape_brush
 {
@@ -20,6 +25,7 @@ static Brush shape_brush
 		"size",
 		"orientation"
 	},
+	.score = shape_score,
 	.draw = shape
 };
 
@@ -32,6 +38,7 @@ static Brush solid_brush
 		"palette",
 		"complexity"
 	},
+	.score = solid_score,
 	.draw = solid
 };
 
@@ -46,6 +53,7 @@ static Brush line_brush
 		"size",
 		"orientation"
 	},
+	.score = line_score,
 	.draw = line
 };
 
@@ -60,6 +68,7 @@ static Brush specularhighlight_brush
 		"size",
 		"lighting"
 	},
+	.score = specularhighlight_score,
 	.draw = specularhighlight
 };
 #endif
@@ -0,0 +1,313 @@
+// C imports
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// C++ imports
+#include <string>
+#include <vector>
+
+// Module imports
+#include "checkpoint.h"
+
+// File header: magic, version, grid and section count, then the table
+static const char MAGIC[8] = {'T','E','M','P','E','R','E','C'};
+static const uint64_t VERSION = 3;
+
+uint32_t ckpt::Strings::intern(const std::string& str)
+{
+	auto found = index.find(str);
+	if(found != index.end()) { return found->second; }
+	uint32_t id = list.size();
+	list.push_back(str);
+	index[str] = id;
+	return id;
+}
+
+void ckpt::Writer::fixed(uint64_t val)
+{
+	for(int i = 0; i < 8; i++) { data.push_back((val >> (8 * i)) & 0xff); }
+}
+
+void ckpt::Writer::varint(uint64_t val)
+{
+	while(val >= 0x80)
+	{
+		data.push_back((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	data.push_back(val);
+}
+
+void ckpt::Writer::zigzag(int64_t val)
+{
+	varint(((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+void ckpt::Writer::real(double val)
+{
+	uint64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	fixed(bits);
+}
+
+void ckpt::Writer::string(const std::string& str)
+{
+	varint(str.size());
+	data.insert(data.end(), str.begin(), str.end());
+}
+
+void ckpt::Writer::ids(const std::vector<uint32_t>& list)
+{
+	varint(list.size());
+	int64_t prev = 0;
+	for(auto id : list) { zigzag((int64_t)id - prev); prev = id; }
+}
+
+void ckpt::Writer::idset(const std::set<uint32_t>& set)
+{
+	varint(set.size());
+	uint32_t prev = 0;
+	for(auto id : set) { varint(id - prev); prev = id; }
+}
+
+void ckpt::Writer::vertices(const std::vector<Vertex>& list)
+{
+	varint(list.size());
+	int64_t px = 0;
+	int64_t py = 0;
+	for(auto v : list)
+	{
+		int64_t x = llround(ldexp(v.x, GRID));
+		int64_t y = llround(ldexp(v.y, GRID));
+		zigzag(x - px);
+		zigzag(y - py);
+		px = x;
+		py = y;
+	}
+}
+
+void ckpt::Writer::idmap(const std::map<uint32_t,uint32_t>& map)
+{
+	varint(map.size());
+	uint32_t prev = 0;
+	for(auto & [k,v] : map) { varint(k - prev); varint(v); prev = k; }
+}
+
+void ckpt::Writer::relation(const std::map<uint32_t,std::set<uint32_t>>& map)
+{
+	varint(map.size());
+	uint32_t prev = 0;
+	for(auto & [k,v] : map) { varint(k - prev); idset(v); prev = k; }
+}
+
+uint64_t ckpt::Reader::fixed()
+{
+	if(!ok || end - at < 8) { ok = false; return 0; }
+	uint64_t val = 0;
+	for(int i = 0; i < 8; i++) { val |= (uint64_t)at[i] << (8 * i); }
+	at += 8;
+	return val;
+}
+
+uint64_t ckpt::Reader::varint()
+{
+	uint64_t val = 0;
+	for(int shift = 0; ok && shift < 64; shift += 7)
+	{
+		if(at == end) { break; }
+		uint8_t byte = *at++;
+		val |= (uint64_t)(byte & 0x7f) << shift;
+		if(!(byte & 0x80)) { return val; }
+	}
+	ok = false;
+	return 0;
+}
+
+int64_t ckpt::Reader::zigzag()
+{
+	uint64_t val = varint();
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+double ckpt::Reader::real()
+{
+	uint64_t bits = fixed();
+	double val;
+	memcpy(&val, &bits, sizeof(val));
+	return val;
+}
+
+std::string ckpt::Reader::string()
+{
+	uint64_t size = varint();
+	if(!ok || (uint64_t)(end - at) < size) { ok = false; return ""; }
+	std::string ret((const char*)at, size);
+	at += size;
+	return ret;
+}
+
+std::vector<uint32_t> ckpt::Reader::ids()
+{
+	std::vector<uint32_t> ret;
+	uint64_t size = varint();
+	int64_t prev = 0;
+	for(uint64_t i = 0; ok && i < size; i++)
+	{
+		prev += zigzag();
+		ret.push_back(prev);
+	}
+	return ret;
+}
+
+std::set<uint32_t> ckpt::Reader::idset()
+{
+	std::set<uint32_t> ret;
+	uint64_t size = varint();
+	uint32_t prev = 0;
+	for(uint64_t i = 0; ok && i < size; i++)
+	{
+		prev += varint();
+		ret.insert(ret.end(), prev);
+	}
+	return ret;
+}
+
+std::vector<Vertex> ckpt::Reader::vertices()
+{
+	std::vector<Vertex> ret;
+	uint64_t size = varint();
+	int64_t x = 0;
+	int64_t y = 0;
+	for(uint64_t i = 0; ok && i < size; i++)
+	{
+		x += zigzag();
+		y += zigzag();
+		ret.push_back({ldexp((double)x, -(int)GRID), ldexp((double)y, -(int)GRID)});
+	}
+	return ret;
+}
+
+std::map<uint32_t,uint32_t> ckpt::Reader::idmap()
+{
+	std::map<uint32_t,uint32_t> ret;
+	uint64_t size = varint();
+	uint32_t prev = 0;
+	for(uint64_t i = 0; ok && i < size; i++)
+	{
+		prev += varint();
+		ret.emplace_hint(ret.end(), prev, varint());
+	}
+	return ret;
+}
+
+std::map<uint32_t,std::set<uint32_t>> ckpt::Reader::relation()
+{
+	std::map<uint32_t,std::set<uint32_t>> ret;
+	uint64_t size = varint();
+	uint32_t prev = 0;
+	for(uint64_t i = 0; ok && i < size; i++)
+	{
+		prev += varint();
+		ret.emplace_hint(ret.end(), prev, idset());
+	}
+	return ret;
+}
+
+bool ckpt::write(std::string filename, const std::vector<Section>& sections)
+{
+	// Lay out the payloads after the header, each aligned to 8 bytes
+	uint64_t offset = sizeof(MAGIC) + 3 * 8 + sections.size() * 3 * 8;
+	Writer head;
+	head.fixed(VERSION);
+	head.fixed(GRID);
+	head.fixed(sections.size());
+	for(auto& s : sections)
+	{
+		head.fixed(((uint64_t)s.key << 32) | s.kind);
+		head.fixed(offset);
+		head.fixed(s.data.bytes().size());
+		offset += (s.data.bytes().size() + 7) & ~7ull;
+	}
+	FILE* file = fopen(filename.c_str(), "wb");
+	if(file == NULL) { return false; }
+	static const uint8_t pad[8] = {0};
+	bool ok = fwrite(MAGIC, sizeof(MAGIC), 1, file) == 1;
+	ok = ok && fwrite(head.bytes().data(), head.bytes().size(), 1, file) == 1;
+	for(auto& s : sections)
+	{
+		uint64_t size = s.data.bytes().size();
+		if(size == 0) { continue; }
+		ok = ok && fwrite(s.data.bytes().data(), size, 1, file) == 1;
+		uint64_t extra = ((size + 7) & ~7ull) - size;
+		ok = ok && (extra == 0 || fwrite(pad, extra, 1, file) == 1);
+	}
+	return fclose(file) == 0 && ok;
+}
+
+ckpt::Map::Map(std::string filename)
+{
+	base = NULL;
+	length = 0;
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) { return; }
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(MAGIC))
+	{
+		close(fd);
+		return;
+	}
+	void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) { return; }
+	const uint8_t* bytes = (const uint8_t*)map;
+	// Check the header and read the section table
+	Reader head(bytes + sizeof(MAGIC), info.st_size - sizeof(MAGIC));
+	bool ok = memcmp(bytes, MAGIC, sizeof(MAGIC)) == 0;
+	ok = ok && head.fixed() == VERSION;
+	ok = ok && head.fixed() == GRID;
+	uint64_t count = ok ? head.fixed() : 0;
+	for(uint64_t i = 0; ok && head.good() && i < count; i++)
+	{
+		uint64_t id = head.fixed();
+		Entry e = {(SECTION)(id & 0xffffffff), (uint32_t)(id >> 32),
+			head.fixed(), head.fixed()};
+		ok = e.offset <= (uint64_t)info.st_size &&
+			e.size <= (uint64_t)info.st_size - e.offset;
+		table.push_back(e);
+	}
+	if(!ok || !head.good())
+	{
+		munmap(map, info.st_size);
+		table.clear();
+		return;
+	}
+	base = map;
+	length = info.st_size;
+}
+
+ckpt::Map::~Map()
+{
+	if(base != NULL) { munmap(base, length); }
+}
+
+std::vector<uint32_t> ckpt::Map::keys(SECTION kind) const
+{
+	std::vector<uint32_t> ret;
+	for(auto& e : table) { if(e.kind == kind) { ret.push_back(e.key); } }
+	return ret;
+}
+
+ckpt::Reader ckpt::Map::section(SECTION kind, uint32_t key) const
+{
+	for(auto& e : table)
+	{
+		if(e.kind != kind || e.key != key) { continue; }
+		return Reader((const uint8_t*)base + e.offset, e.size);
+	}
+	return Reader();
+}
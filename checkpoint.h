@@ -0,0 +1,117 @@
+// C imports
+#include <stdint.h>
+
+// C++ imports
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+// Module imports
+#include "geom.h"
+
+#ifndef checkpoint_h
+#define checkpoint_h
+using geom::Vertex;
+// A checkpoint is a header, a table of sections and the section payloads.
+// Every payload starts on an 8 byte boundary, so a mapped file can be read in
+// place and any section found without decoding the ones before it. Inside a
+// section numbers are varints, ids are delta coded and coordinates are snapped
+// to a fixed grid and delta coded, which keeps vertex pools small.
+namespace ckpt
+{
+	// The kinds of section in a checkpoint
+	enum SECTION : uint32_t {STRINGS, WORKSPACE, LAYER};
+	// Coordinates are stored as multiples of 2^-GRID, far below geom::EPS
+	const uint32_t GRID = 32;
+
+	// Strings are written once and referred to by index
+	class Strings
+	{
+		std::vector<std::string> list;
+		std::map<std::string,uint32_t> index;
+		public:
+			uint32_t intern(const std::string&);
+			const std::vector<std::string>& all() const { return list; }
+	};
+
+	// Appends encoded values to a growing payload
+	class Writer
+	{
+		std::vector<uint8_t> data;
+		public:
+			void fixed(uint64_t);
+			void varint(uint64_t);
+			void zigzag(int64_t);
+			void real(double);
+			void string(const std::string&);
+			// Delta coded lists, sets are sorted so their deltas are positive
+			void ids(const std::vector<uint32_t>&);
+			void idset(const std::set<uint32_t>&);
+			void vertices(const std::vector<Vertex>&);
+			void idmap(const std::map<uint32_t,uint32_t>&);
+			void relation(const std::map<uint32_t,std::set<uint32_t>>&);
+			const std::vector<uint8_t>& bytes() const { return data; }
+	};
+
+	// Decodes values from a payload in place. Reading past the end returns
+	// zeros and marks the reader as failed instead of overrunning the map.
+	class Reader
+	{
+		const uint8_t* at;
+		const uint8_t* end;
+		bool ok;
+		public:
+			Reader() : at{NULL}, end{NULL}, ok{false} {};
+			Reader(const uint8_t* begin, uint64_t size) :
+				at{begin}, end{begin + size}, ok{begin != NULL} {};
+			uint64_t fixed();
+			uint64_t varint();
+			int64_t zigzag();
+			double real();
+			std::string string();
+			std::vector<uint32_t> ids();
+			std::set<uint32_t> idset();
+			std::vector<Vertex> vertices();
+			std::map<uint32_t,uint32_t> idmap();
+			std::map<uint32_t,std::set<uint32_t>> relation();
+			bool good() const { return ok; }
+	};
+
+	typedef struct section
+	{
+		SECTION kind;
+		uint32_t key;
+		Writer data;
+	} Section;
+
+	// Write all sections to a file, false if the file could not be written
+	bool write(std::string filename, const std::vector<Section>& sections);
+
+	// A read-only mapping of a checkpoint file
+	class Map
+	{
+		void* base;
+		uint64_t length;
+		typedef struct entry
+		{
+			SECTION kind;
+			uint32_t key;
+			uint64_t offset;
+			uint64_t size;
+		} Entry;
+		std::vector<Entry> table;
+		public:
+			Map(std::string filename);
+			~Map();
+			Map(const Map&) = delete;
+			Map& operator=(const Map&) = delete;
+			// False if the file is missing, truncated or not a checkpoint
+			bool good() const { return base != NULL; }
+			// The keys of every section of a kind, in file order
+			std::vector<uint32_t> keys(SECTION kind) const;
+			// A reader over one section, failed if there is no such section
+			Reader section(SECTION kind, uint32_t key) const;
+	};
+};
+#endif
@@ -5,6 +5,10 @@
 #include <stdexcept>
 #include <vector>
 #include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <algorithm>
 
 // Module imports
 #include "render.h"
@@ -13,6 +17,83 @@
 
 using namespace dst;
 
+// The interned names. Brushes build constraints on many threads, so the table
+// is locked, and a deque keeps the names in place as it grows.
+typedef struct interned
+{
+	std::mutex lock;
+	std::deque<std::string> name;
+	std::map<std::string,uint32_t> key;
+	interned()
+	{
+		for(auto n : {"size","complexity","orientation","perturbation",
+			"lighting","palette"}) { key[n] = name.size(); name.push_back(n); }
+	}
+} Names;
+
+Names& names()
+{
+	static Names table;
+	return table;
+}
+
+uint32_t cst::key(const std::string& n)
+{
+	Names& t = names();
+	std::lock_guard<std::mutex> hold(t.lock);
+	auto found = t.key.find(n);
+	if(found != t.key.end()) { return found->second; }
+	t.key[n] = t.name.size();
+	t.name.push_back(n);
+	return t.name.size() - 1;
+}
+
+const std::string& cst::name(uint32_t key)
+{
+	Names& t = names();
+	std::lock_guard<std::mutex> hold(t.lock);
+	return t.name.at(key);
+}
+
+cst::Keys::Keys(std::initializer_list<std::string> names)
+{
+	// Sorted and unique by name, as the sets of names were
+	std::set<std::string> sorted(names);
+	for(auto& n : sorted) { key.push_back(cst::key(n)); }
+}
+
+cst::Table cst::table(std::vector<Constraint> con)
+{
+	// A stable sort keeps the constraints of one key in the order given
+	std::stable_sort(con.begin(), con.end(),
+		[](const Constraint& a, const Constraint& b) { return a.key < b.key; });
+	Table ret;
+	uint32_t k = con.size() == 0 ? 0 : con.back().key + 1;
+	ret.slot.assign(k + 1, 0);
+	ret.dials.assign(k, 0);
+	for(auto& c : con)
+	{
+		ret.slot[c.key + 1]++;
+		if(!(c.type==DIST::NONE)) { ret.dials[c.key]++; }
+	}
+	for(uint32_t i = 0; i < k; i++) { ret.slot[i+1] += ret.slot[i]; }
+	ret.con = std::move(con);
+	return ret;
+}
+
+cst::Table cst::merge(const Table& t, const std::vector<Constraint>& over)
+{
+	std::vector<Constraint> con;
+	for(auto& c : t.con)
+	{
+		bool kept = true;
+		for(auto& o : over) { kept = kept && o.key != c.key; }
+		if(kept) { con.push_back(c); }
+	}
+	con.insert(con.end(), over.begin(), over.end());
+	return table(con);
+}
+
 SizeFactory::SizeFactory()
 {
 	name = "size";
@@ -61,32 +142,34 @@ Constraint ConstraintFactory::create()
 		case INITTYPE::DIAL:
 			if(dist.size() < 1)
 			{
-				return { name, DIST::DDELTA, (uint32_t)-1, 0.5};
+				return { cst::key(name), DIST::DDELTA, (uint32_t)-1, 0.5};
 			}
-			return { name, dist[0], 0, 0.5 };
+			return { cst::key(name), dist[0], 0, 0.5 };
 		break;
 		case INITTYPE::MASK:
 			if(mask.size() < 1)
 			{
-				return { name, DIST::NONE, 0, -1.0 };
+				return { cst::key(name), DIST::NONE, 0, -1.0 };
 			}
-			return { name, DIST::NONE, mask[0], -1.0 };
+			return { cst::key(name), DIST::NONE, mask[0], -1.0 };
 		break;
 		case INITTYPE::BOTH:
 			if(mask.size() < 1 || dist.size() < 1)
 			{
-				return { name, DIST::NONE, 0, 0.5};
+				return { cst::key(name), DIST::NONE, 0, 0.5};
 			}
-			return { name, dist[0], mask[0], 0.5 };
+			return { cst::key(name), dist[0], mask[0], 0.5 };
 		break;
 	};
-	return {"", DIST::NONE, (uint32_t)-1, -1.0 };
+	return { cst::key(""), DIST::NONE, (uint32_t)-1, -1.0 };
 }
 
 
 // Construct a random constraint given a zipfs slot and a rng
-// Higher zipfs values are allowed more variation from the standard
-Constraint ConstraintFactory::create(double zip, std::function<double()> &rand)
+// Higher zipfs values are allowed more variation from the standard. Dials
+// come from a block shared by the constraints made together.
+Constraint ConstraintFactory::create(
+	double zip, rng::Random &rand, dst::Block &dials)
 {
 	auto avgdistribution = [&](double a, double b) mutable -> double
 	{
@@ -103,32 +186,32 @@ Constraint ConstraintFactory::create(double zip, std::function<double()> &rand)
 	uint32_t sizmask = mask.size();
 	uint32_t maskidx = dst::discrete_sample(dist[distidx], sizmask, rand);
 	// For the dial also base it on the type
-	double dial = dst::continuous_sample(dist[distidx], rand);
+	double dial = dials.next(dist[distidx], rand);
 	// Now return it
 	switch(type)
 	{
 		case INITTYPE::DIAL:
-			return { name, dist[distidx], 0, dial };
+			return { cst::key(name), dist[distidx], 0, dial };
 		break;
 		case INITTYPE::MASK:
-			return { name, DIST::NONE, mask[maskidx], -1.0 };
+			return { cst::key(name), DIST::NONE, mask[maskidx], -1.0 };
 		break;
 		case INITTYPE::BOTH:
-			return { name, dist[distidx], mask[maskidx], dial };
+			return { cst::key(name), dist[distidx], mask[maskidx], dial };
 		break;
 	}
-	return {"", DIST::NONE, (uint32_t)-1, -1.0 };
+	return { cst::key(""), DIST::NONE, (uint32_t)-1, -1.0 };
 }
 
-std::function<double(std::function<double()>)> distribution(
+std::function<double(rng::Random&)> distribution(
 	std::vector<Match> match)
 {
 	// Choose which match to choose based on type and dial
 	std::vector<Match> copy = {};
 	for(auto m : match) { if(!(m.type==DIST::NONE)) { copy.push_back(m); } }
-	auto zerolam = [=](std::function<double()>) -> double { return -1.0; };
+	auto zerolam = [=](rng::Random&) -> double { return -1.0; };
 	if(copy.size() == 0) { return zerolam; }
-	auto ret = [=](std::function<double()> rng) mutable -> double {
+	auto ret = [=](rng::Random& rng) mutable -> double {
 		double choice = rng();
 		uint32_t idx = int(floor(choice * copy.size()));
 		// TODO: gaussians / distributions?
@@ -137,14 +220,45 @@ std::function<double(std::function<double()>)> distribution(
 	return ret;
 }
 
+Matches match_constraint(const cst::Table& t, uint32_t key)
+{
+	if(key >= t.dials.size()) { return Matches(); }
+	const Constraint* data = t.con.data();
+	uint32_t first = t.slot[key];
+	return Matches(data + first, data + t.slot[key+1], first);
+}
+
+// A key the segment sets hides the defaults of that key
+const cst::Table& resolve(const Segment& s, uint32_t key)
+{
+	const cst::Table& own = *s.own;
+	bool set = key < own.dials.size() && own.slot[key] < own.slot[key+1];
+	return set ? own : *s.base;
+}
+
+Matches match_constraint(const Segment& s, uint32_t key)
+{
+	return match_constraint(resolve(s, key), key);
+}
+
+double draw(const Segment& s, uint32_t key, rng::Random& rng)
+{
+	const cst::Table& t = resolve(s, key);
+	if(key >= t.dials.size() || t.dials[key] == 0) { return -1.0; }
+	// As in distribution, the index is over the dials but picks a match
+	double choice = rng();
+	uint32_t idx = int(floor(choice * t.dials[key]));
+	return t.con[t.slot[key] + idx].dial;
+}
+
 std::vector<Match> match_constraint(std::string s, std::vector<Constraint> cons)
 {
 	std::vector<Match> ret;
+	uint32_t key = cst::key(s);
 	uint32_t i = 0;
-	for(auto x : cons)
+	for(auto& x : cons)
 	{
-		bool eq = s.compare(x.name);
-		if(eq==0) { ret.push_back({i, x.type, x.mask, x.dial}); }
+		if(x.key == key) { ret.push_back({i, x.type, x.mask, x.dial}); }
 		i++;
 	}
 	return ret;
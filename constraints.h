@@ -25,7 +25,7 @@ class ConstraintFactory
 		std::vector<uint32_t> mask;
 	public:
 		virtual Constraint create();
-		virtual Constraint create(double, std::function<double()>&);
+		virtual Constraint create(double, rng::Random&, dst::Block&);
 };
 
 
@@ -67,6 +67,46 @@ typedef struct match
 	double dial;
 } Match;
 
+// The constraints of one key on a segment, numbered by their place in the
+// table they are read from. It reads the table in place, so it is only valid
+// while the segment is.
+class Matches
+{
+	const Constraint* first;
+	const Constraint* last;
+	uint32_t base;
+	public:
+		class iterator
+		{
+			const Constraint* at;
+			uint32_t i;
+			public:
+				iterator(const Constraint* a, uint32_t i) : at{a}, i{i} {};
+				Match operator*() const
+				{
+					return {i, at->type, at->mask, at->dial};
+				}
+				iterator& operator++() { at++; i++; return *this; }
+				bool operator!=(const iterator& o) const { return at != o.at; }
+		};
+		Matches() : first{NULL}, last{NULL}, base{0} {};
+		Matches(const Constraint* f, const Constraint* l, uint32_t b) :
+			first{f}, last{l}, base{b} {};
+		iterator begin() const { return iterator(first, base); }
+		iterator end() const { return iterator(last, base); }
+		uint32_t size() const { return last - first; }
+		Match operator[](uint32_t i) const
+		{
+			return *iterator(first + i, base + i);
+		}
+};
+
+Matches match_constraint(const cst::Table&, uint32_t key);
+Matches match_constraint(const Segment&, uint32_t key);
+// One draw of a segment's dial for a key, -1.0 without drawing if it has none.
+// It reads the counts its tables were built with, so it allocates nothing.
+double draw(const Segment&, uint32_t key, rng::Random&);
+
 std::vector<Match> match_constraint(std::string, std::vector<Constraint> cons);
-std::function<double(std::function<double()>)> distribution(std::vector<Match>);
+std::function<double(rng::Random&)> distribution(std::vector<Match>);
 #endif
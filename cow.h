@@ -0,0 +1,112 @@
+// C++ imports
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <cstddef>
+
+#ifndef cow_h
+#define cow_h
+// Copy-on-write storage. Copies share their data and only the holder that
+// writes pays for a copy, so forking a workspace does not copy its geometry.
+// A value may be copied and read on many threads, but each copy is written by
+// one thread at a time.
+namespace cow
+{
+	// A fresh owner token, never zero
+	inline uint64_t token()
+	{
+		static std::atomic<uint64_t> next {1};
+		return next.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <typename T>
+	class Cow
+	{
+		// The shared data names the one holder that may write it in place.
+		// Copying clears the owner, so after a fork every holder copies
+		// before it writes. Sharing is never guessed from reference counts,
+		// which other threads may be changing.
+		typedef struct box
+		{
+			T val;
+			std::atomic<uint64_t> owner;
+			box(T v, uint64_t o) : val{std::move(v)}, owner{o} {};
+		} Box;
+		std::shared_ptr<Box> ptr;
+		uint64_t own;
+		public:
+			Cow() : Cow(T()) {};
+			Cow(T val) : own{token()}
+			{
+				ptr = std::make_shared<Box>(std::move(val), own);
+			};
+			Cow(const Cow& o) : ptr{o.ptr}, own{token()}
+			{
+				ptr->owner.store(0, std::memory_order_release);
+			};
+			Cow(Cow&&) noexcept = default;
+			Cow& operator=(const Cow& o)
+			{
+				if(this == &o) { return *this; }
+				ptr = o.ptr;
+				own = token();
+				ptr->owner.store(0, std::memory_order_release);
+				return *this;
+			}
+			Cow& operator=(Cow&&) noexcept = default;
+			const T& operator*() const { return ptr->val; }
+			const T* operator->() const { return &ptr->val; }
+			// Writable data, copied first unless this holder owns it
+			T& edit()
+			{
+				if(ptr->owner.load(std::memory_order_acquire) != own)
+				{
+					ptr = std::make_shared<Box>(ptr->val, own);
+				}
+				return ptr->val;
+			}
+	};
+
+	// A vector stored in fixed size chunks. Appending after a copy copies
+	// the chunk index and the last chunk, never the whole vector.
+	template <typename T, size_t N = 64>
+	class Chunks
+	{
+		typedef std::vector<T> Chunk;
+		Cow<std::vector<Cow<Chunk>>> chunk;
+		size_t count = 0;
+		public:
+			Chunks() {};
+			Chunks(const std::vector<T>& vals)
+			{
+				for(auto& v : vals) { push_back(v); }
+			}
+			size_t size() const { return count; }
+			const T& operator[](size_t i) const
+			{
+				return (*(*chunk)[i / N])[i % N];
+			}
+			void push_back(const T& val)
+			{
+				auto& index = chunk.edit();
+				if(count % N == 0)
+				{
+					Chunk fresh;
+					fresh.reserve(N);
+					index.push_back(Cow<Chunk>(std::move(fresh)));
+				}
+				// Only the last chunk is ever written, full ones stay shared
+				index.back().edit().push_back(val);
+				count++;
+			}
+			std::vector<T> flat() const
+			{
+				std::vector<T> ret;
+				ret.reserve(count);
+				for(auto& c : *chunk) { ret.insert(ret.end(), c->begin(), c->end()); }
+				return ret;
+			}
+	};
+};
+#endif
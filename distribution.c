@@ -1,13 +1,15 @@
 #include <math.h>
+#include <string.h>
 
 #include "distribution.h"
 double clamp(double s)
 {
 	if(s < 0.0) { return 0.0; }
 	if(s > 1.0) { return 1.0; }
+	return s;
 }
 
-double gaussian(std::function<double()> &r)
+double gaussian(rng::Random &r)
 {
 	double C = 0.2;
 	double s1 = r();
@@ -16,7 +18,7 @@ double gaussian(std::function<double()> &r)
 	return ret * C;
 }
 
-double dst::continuous_sample(dst::DIST type, std::function<double()> &r)
+double dst::continuous_sample(dst::DIST type, rng::Random &r)
 {
 	switch(type)
 	{
@@ -32,10 +34,146 @@ double dst::continuous_sample(dst::DIST type, std::function<double()> &r)
 		}
 		case dst::DIST::NONE: return 0.0;
 	}
+	return 0.0;
+}
+
+// Block samples are made this many at a time, in loops of fixed width
+static const uint32_t LANES = 8;
+
+// The natural log of x > 0. The exponent is split off and the mantissa moved
+// into [sqrt(1/2), sqrt(2)), where an odd series in (m-1)/(m+1) converges
+// to about 1e-11 in six terms.
+inline double fast_log(double x)
+{
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	double e = (double)((int64_t)((bits >> 52) & 0x7FF) - 1023);
+	bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+	double m;
+	memcpy(&m, &bits, sizeof(m));
+	bool big = m > M_SQRT2;
+	m = big ? m * 0.5 : m;
+	e = big ? e + 1.0 : e;
+	double s = (m - 1.0) / (m + 1.0);
+	double s2 = s * s;
+	double p = 2.0/11.0;
+	p = 2.0/9.0 + s2 * p;
+	p = 2.0/7.0 + s2 * p;
+	p = 2.0/5.0 + s2 * p;
+	p = 2.0/3.0 + s2 * p;
+	p = 2.0 + s2 * p;
+	return e * M_LN2 + s * p;
+}
+
+// The sine and cosine of 2 pi u for u in [0,1). The turn is cut into
+// quadrants, and within one Taylor series about its middle are good to
+// about 1e-11.
+inline void fast_sincos(double u, double& sn, double& cs)
+{
+	double t = u * 4.0;
+	int q = (int)t;
+	double a = (t - q - 0.5) * M_PI_2;
+	double a2 = a * a;
+	double ps = 1.0/39916800.0;
+	ps = 1.0/362880.0 - a2 * ps;
+	ps = 1.0/5040.0 - a2 * ps;
+	ps = 1.0/120.0 - a2 * ps;
+	ps = 1.0/6.0 - a2 * ps;
+	ps = a * (1.0 - a2 * ps);
+	double pc = 1.0/479001600.0;
+	pc = 1.0/3628800.0 - a2 * pc;
+	pc = 1.0/40320.0 - a2 * pc;
+	pc = 1.0/720.0 - a2 * pc;
+	pc = 1.0/24.0 - a2 * pc;
+	pc = 1.0/2.0 - a2 * pc;
+	pc = 1.0 - a2 * pc;
+	// Rotate from the middle of the quadrant, then by whole quadrants
+	double s = (ps + pc) * M_SQRT1_2;
+	double c = (pc - ps) * M_SQRT1_2;
+	sn = q == 0 ? s : q == 1 ? c : q == 2 ? -s : -c;
+	cs = q == 0 ? c : q == 1 ? -s : q == 2 ? -c : s;
+}
+
+// LANES gaussians, scaled as gaussian() scales them
+void gaussian_block(rng::Random &r, double* out)
+{
+	const uint32_t H = LANES / 2;
+	double u[LANES];
+	for(uint32_t i = 0; i < LANES; i++) { u[i] = r(); }
+	double rad[H];
+	double sn[H];
+	double cs[H];
+	// One minus a uniform is never zero
+	for(uint32_t i = 0; i < H; i++)
+	{
+		rad[i] = 0.2 * sqrt(-2.0 * fast_log(1.0 - u[i]));
+	}
+	for(uint32_t i = 0; i < H; i++) { fast_sincos(u[H + i], sn[i], cs[i]); }
+	for(uint32_t i = 0; i < H; i++)
+	{
+		out[i] = rad[i] * sn[i];
+		out[H + i] = rad[i] * cs[i];
+	}
+}
+
+void dst::continuous_block(
+	dst::DIST type, rng::Random &r, double* out, uint32_t n)
+{
+	double tail[LANES];
+	double g[LANES];
+	double mode[LANES];
+	for(uint32_t i = 0; i < n; i += LANES)
+	{
+		// A last partial block is made whole and the part needed copied
+		uint32_t k = n - i < LANES ? n - i : LANES;
+		double* o = k == LANES ? out + i : tail;
+		switch(type)
+		{
+			case dst::DIST::GAUSSIAN:
+				gaussian_block(r, g);
+				for(uint32_t j = 0; j < LANES; j++)
+				{
+					o[j] = fmin(fmax(g[j] + 0.5, 0.0), 1.0);
+				}
+				break;
+			case dst::DIST::BIMODAL:
+				for(uint32_t j = 0; j < LANES; j++) { mode[j] = r(); }
+				gaussian_block(r, g);
+				for(uint32_t j = 0; j < LANES; j++)
+				{
+					double c = mode[j] < 0.5 ? 0.75 : 0.25;
+					o[j] = fmin(fmax(g[j] + c, 0.0), 1.0);
+				}
+				break;
+			case dst::DIST::UNIFORM:
+				for(uint32_t j = 0; j < k; j++) { o[j] = r(); }
+				break;
+			case dst::DIST::DDELTA:
+				for(uint32_t j = 0; j < k; j++) { o[j] = 0.5; }
+				break;
+			case dst::DIST::NONE:
+				for(uint32_t j = 0; j < k; j++) { o[j] = 0.0; }
+				break;
+		}
+		if(o == tail) { memcpy(out + i, tail, k * sizeof(double)); }
+	}
+}
+
+double dst::Block::next(dst::DIST type, rng::Random &r)
+{
+	std::vector<double>& s = spare[type];
+	if(s.empty())
+	{
+		s.resize(LANES);
+		continuous_block(type, r, s.data(), LANES);
+	}
+	double ret = s.back();
+	s.pop_back();
+	return ret;
 }
 
 uint32_t dst::discrete_sample(
-	dst::DIST type, uint32_t size, std::function<double()> &r)
+	dst::DIST type, uint32_t size, rng::Random &r)
 {
 	double place = continuous_sample(type, r);
 	uint32_t idx = int(floor(size * place));
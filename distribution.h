@@ -1,5 +1,7 @@
-#include <functional>
 #include <cstdint>
+#include <vector>
+
+#include "random.h"
 
 #ifndef distribution_h
 #define distribution_h
@@ -16,7 +18,22 @@ namespace dst
 		NONE
 	};
 
-	double continuous_sample(DIST, std::function<double()> &);
-	uint32_t discrete_sample(DIST, uint32_t, std::function<double()> &);
+	double continuous_sample(DIST, rng::Random &);
+	uint32_t discrete_sample(DIST, uint32_t, rng::Random &);
+	// Fill out with n samples of a distribution, in blocks the compiler can
+	// vectorize. Gaussians come in pairs from one Box-Muller draw, with log
+	// and sine approximated to about 1e-10. The samples follow the same
+	// distributions as continuous_sample, but not the same stream of draws.
+	void continuous_block(DIST, rng::Random &, double* out, uint32_t n);
+
+	// Hands out samples one at a time but makes them a block at a time,
+	// keeping what is left of each distribution's block for the next call
+	class Block
+	{
+		public:
+			double next(DIST, rng::Random &);
+		private:
+			std::vector<double> spare[NONE + 1];
+	};
 };
 #endif
@@ -20,15 +20,15 @@ struct dir_thunk
 	double scale;
 };
 
-const std::map<std::string,struct dir_thunk> thunk_map
+const std::map<uint32_t,struct dir_thunk> thunk_map
 {
-	{"size",
+	{cst::SIZE,
 		{
 			.dir = false,
 			.scale = 0.1
 		}
 	},
-	{"complexity",
+	{cst::COMPLEXITY,
 		{
 			.dir = true,
 			.scale = 0.3
@@ -36,9 +36,9 @@ const std::map<std::string,struct dir_thunk> thunk_map
 	},
 };
 
-const std::function<struct dir_thunk(std::string)> thunk = [](std::string type)
+const std::function<struct dir_thunk(uint32_t)> thunk = [](uint32_t key)
 {
-		try { return thunk_map.at(type); }
+		try { return thunk_map.at(key); }
 		catch(const std::out_of_range &e)
 		{
 			struct dir_thunk ret {false, 0.0};
@@ -59,60 +59,67 @@ double weighted_sum(std::vector<std::pair<double, int>> v_wc)
 	return (sum_c / sum_w);
 }
 
-uint32_t measure_fbg(Workspace* ws, Operator op, Segment s)
+// The figure/ground tendency of a segment, less its layer term. That term
+// depends on the highest layer, so it is added per layer when summing.
+double fbg_part(Workspace* ws, const Segment& s)
 {
-	// Back layers are background
-	uint32_t min = 0;
-	uint32_t max = 0;
-	for(auto &s : ws->cut()) { if(s.layer > max) { max = s.layer; } }
-	int l_r = max - min;
-	double layer = l_r == 0 ? 0.0 : (s.layer) / (1.0 * l_r);
 	// Complexity and size determines foreground and background
-	auto cmpmatch = match_constraint("complexity", s.constraint);
-	auto sizmatch = match_constraint("size", s.constraint);
-	double comp = distribution(cmpmatch)(ws->rand);
-	double size = distribution(sizmatch)(ws->rand);
+	double comp = draw(s, cst::COMPLEXITY, ws->rand);
+	double size = draw(s, cst::SIZE, ws->rand);
 
 	// Depending on the direction we evaluate dials differently
-	std::function<double(double,std::string)> dirlambda =
-	[=](double c, std::string type)
+	std::function<double(double,uint32_t)> dirlambda =
+	[=](double c, uint32_t key)
 	{
-		bool dir = thunk(type).dir;
+		bool dir = thunk(key).dir;
 		return dir ? c : 1.0 - c;
 	};
-	//printf("COMP SIZ: %f %f\n",comp, size);
-
-	comp = dirlambda(comp, "complexity");
-	size = dirlambda(size, "size");
-
-	//printf("COMP SIZ: %f %f\n",comp, size);
+	comp = dirlambda(comp, cst::COMPLEXITY);
+	size = dirlambda(size, cst::SIZE);
 
 	std::vector<std::pair<double, int>> weighted_components
 	{
-		{layer, 10}, // Which layer the element is in
+		{0.0, 10}, // Which layer the element is in, added by fbg_layer
 		{comp, 8}, // The complexity of the layer
 		{size, 6},
 	};
-	// double w_sum = weighted_sum(weighted_components);
-	return int(256.0 * weighted_sum(weighted_components));
+	return 256.0 * weighted_sum(weighted_components);
+}
+
+// Back layers are background
+double fbg_layer(uint32_t layer, uint32_t top)
+{
+	double place = top == 0 ? 0.0 : layer / (1.0 * top);
+	return 256.0 * weighted_sum({{place, 10}, {0.0, 8}, {0.0, 6}});
 }
 
-void update_fbg_cache(Workspace* ws, Operator op)
+// Bring the tally up to date with the segments changed since it was last
+// read, so only those are measured again
+agg::Tally& fbg_tally(Workspace* ws, const Operator& op)
 {
-	// Find matching segments!
-	for(auto s : ws->cut())
+	agg::Tally& t = ws->op_stats[op.name].edit();
+	const cow::Chunks<Change>& log = ws->changes();
+	if(!t.primed)
 	{
-		uint32_t place = 0;
-		if(ws->op_cache[op].count(s) >= 1)
+		for(uint32_t i = 0; i < ws->cutSize(); i++)
 		{
-			place = ws->op_cache[op][s];
-		}
-		else
-		{
-			place = measure_fbg(ws, op, s);
-			ws->op_cache[op][s] = place;
+			const Segment& s = ws->cutAt(i);
+			t.set(s.uid, s.layer, fbg_part(ws, s));
 		}
+		t.cursor = log.size();
+		t.primed = true;
+		return t;
+	}
+	for(; t.cursor < log.size(); t.cursor++)
+	{
+		Change c = log[t.cursor];
+		const Segment* s = ws->find(c.uid);
+		if(c.kind == Change::REMOVED || s == NULL) { t.erase(c.uid); continue; }
+		// The operator's own nudges are measured but not nudged again
+		bool own = t.cursor >= t.ownFrom && t.cursor < t.ownTo;
+		t.set(c.uid, s->layer, fbg_part(ws, *s), !own);
 	}
+	return t;
 }
 
 struct stats
@@ -131,67 +138,63 @@ void tweak_segment(Segment s, double dis)
 }
 
 
-// Increase contrast by nudging segments away from each other
+// Increase contrast by nudging segments away from each other. Only the
+// segments changed since the last nudge are moved.
 void fbglambda(Workspace* ws, Operator op, struct stats stats)
 {
-	printf("FOREGROUND BACKGROUND...\n");
+	agg::Tally& t = fbg_tally(ws, op);
+	uint32_t top = t.top();
+	t.ownFrom = ws->changes().size();
 	// Increase contrast by moving segments away from mean
-	for(auto s : ws->cut())
+	for(auto uid : t.take())
 	{
-		double measure = 1.0 * ws->op_cache[op][s];
-		for(auto c : op.cons)
+		const Segment* s = ws->find(uid);
+		if(s == NULL) { continue; }
+		double measure = t.get(uid) + fbg_layer(s->layer, top);
+		for(auto key : op.cons)
 		{
-			for(auto m : match_constraint(c, s.constraint))
+			for(auto m : match_constraint(*s, key))
 			{
 				double prev = m.dial;
-				bool left = thunk(c).dir;
-				double scale = thunk(c).scale;
+				bool left = thunk(key).dir;
+				double scale = thunk(key).scale;
 				double del = (stats.mean - measure) / 256.0;
 				del = left ? -1.0 * del : del;
 				// Make sure the new dial has increased contrast
 				double dis = del < 0.0 ? prev : 1.0 - prev;
 				// Make a new constraint
 				double next = prev + (dis * del * scale);
-				Constraint n {c, 0, 0, next};
-				ws->setConstraint(op,s,{n});
+				Constraint n {key, 0, 0, next};
+				ws->setConstraint(op,*s,{n});
 			}
 		}
-		// Reset the cache
-		ws->op_cache[op].erase(s);
 	}
+	t.ownTo = ws->changes().size();
 }
 
-// The basic idea is to create connected foreground areas of high complexity
-// and connected areas of background with low complexity.
-Callback figureandground(Workspace* ws, Operator op)
+// Figure and ground statistics over the whole workspace, from the running
+// statistics of each layer
+struct stats fbg_stats(Workspace* ws, const Operator& op)
 {
-	// Cache the info we need for ground manipulation
-	update_fbg_cache(ws, op);
-	// Is there a large enough statistic between foreground and background?
-	uint32_t min = 255;
-	uint32_t max = 0;
-	double sum = 0.0;
-	double sq_sum = 0.0;
-	double n = 0.0;
-	for(auto s : ws->cut())
-	{
-		uint32_t fbg_tendency = ws->op_cache[op][s];
-		min = fbg_tendency < min ? fbg_tendency : min;
-		max = fbg_tendency > max ? fbg_tendency : max;
-		sum += fbg_tendency;
-		sq_sum += fbg_tendency * fbg_tendency;
-		n += 1.0;
-	}
-	double mean = sum / n;
-	double variance = sq_sum / n - mean * mean;
+	agg::Tally& t = fbg_tally(ws, op);
+	uint32_t top = t.top();
+	agg::Summary sum =
+		t.total([=](uint32_t layer) { return fbg_layer(layer, top); });
 	struct stats s = 
 	{
-		.range = 1.0 * (max - min),
-		.mean = mean,
-		.variance = variance,
-		.sd = sqrt(variance)
+		.range = sum.max - sum.min,
+		.mean = sum.mean,
+		.variance = sum.variance,
+		.sd = sqrt(sum.variance)
 	};
+	return s;
+}
 
+// The basic idea is to create connected foreground areas of high complexity
+// and connected areas of background with low complexity.
+Score figureandground_score(Workspace* ws, const Operator& op)
+{
+	struct stats s = fbg_stats(ws, op);
 	// Large SD and range shows clear figure/ground seperation
 	// So we want to apply figure/ground when there is little of it
 	bool usable = s.sd > (256.0 / 40.0) ? true : false;
@@ -199,14 +202,10 @@ Callback figureandground(Workspace* ws, Operator op)
 		(s.sd / 256.0 / 4.0) * 0.5
 		+ (s.range / 256.0) * 0.5;
 	double match = 1.0 - contrast; // We want to drive towards seperation
+	return {usable, match, 1.0};
+}
 
-	Callback ret
-	{
-		.usable = usable,
-		.match = match,
-		.priority = 1.0,
-		.callback = [=]() -> void { fbglambda(ws, op, s); }
-	};
-
-	return ret;
+void figureandground(Workspace* ws, const Operator& op)
+{
+	fbglambda(ws, op, fbg_stats(ws, op));
 }
@@ -5,10 +5,12 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <algorithm>
 
 #include <iostream>
 
 // module imports
+#include "graph.h"
 #include "render.h"
 #include "operators.h"
 #include "constraints.h"
@@ -19,18 +21,17 @@ using namespace geom;
 std::set<uint32_t> fp_indexes(Workspace* ws, Operator op)
 {
 	std::set<uint32_t> ret;
-	std::vector<Segment> cut = ws->cut();
-	for(uint32_t i = 0; i < cut.size(); i++)
+	for(uint32_t i = 0; i < ws->cutSize(); i++)
 	{
+		const Segment& s = ws->cutAt(i);
 		try
 		{
-			if(ws->op_cache[op].at(cut[i]) == (uint32_t)-1)
+			if(ws->op_cache[op]->at(s) == (uint32_t)-1)
 			{
 				ret.emplace(i);
 			}
-			else if(ws->op_cache[op][cut[i]] == i)
+			else if(ws->op_cache[op]->at(s) == i)
 			{
-				printf("FPIDX: %i -- %i\n",i,ws->op_cache[op][cut[i]]);
 				ret.emplace(i);
 			}
 		} catch(std::out_of_range &e) { continue; }
@@ -38,32 +39,60 @@ std::set<uint32_t> fp_indexes(Workspace* ws, Operator op)
 	return ret;
 }
 
-// Find the complexity-weighted distance to a focal point
-// TODO: ADD OTHER CONSTRAINT WEIGHTS!
-// TODO: This is occasionally called with incorrect fp
-double fp_dis(Workspace* ws, Operator op, Segment s, uint32_t fp)
+// Complexity-weighted distances over the segment graph from each focal
+// point. A focal point is a degenerate segment with no edges, so its search
+// starts from the segments around it too. Unreached segments are infinitely
+// far away.
+typedef struct fpmap
+{
+	std::vector<uint32_t> fp;
+	std::vector<std::vector<double>> dist;
+} FPMAP;
+
+FPMAP fp_map(Workspace* ws, std::set<uint32_t> fp_idx)
 {
-	if(fp == (uint32_t)-1) { return 0.0; }
-	Vertex dest = centroid(s.boundary);
-	double ret = 0.0;
-	Vertex o = centroid(ws->cut()[fp].boundary);
-	Vertex dir = vec(o,dest);
-	for(auto other_s : ws->cut())
+	FPMAP ret;
+	std::vector<Segment> cut = ws->cut();
+	// Crossing a segment costs its complexity per unit length
+	std::vector<Vertex> mid;
+	std::vector<double> cmp;
+	for(auto& s : cut)
 	{
-		std::vector<Vertex> itrs = intersect_ray_poly(
-			other_s.boundary,o,dir);
-		auto cmpm = match_constraint("complexity", other_s.constraint);
-		double cmp = distribution(cmpm)(ws->rand);
-		switch(itrs.size())
+		cmp.push_back(draw(s, cst::COMPLEXITY, ws->rand));
+		mid.push_back(centroid(s.boundary));
+	}
+	auto weight = [&](uint32_t a, uint32_t b) -> double
+	{
+		return arclen(Edge{mid[a],mid[b]}) * (cmp[a] + cmp[b]) / 2.0;
+	};
+	for(auto p : fp_idx)
+	{
+		std::vector<uint32_t> src {p};
+		for(uint32_t i = 0; i < cut.size(); i++)
 		{
-			case 0: continue;
-			case 1:
-				ret += arclen(Edge{itrs[0],dest}) * cmp;
-				break;
-			case 2:
-				ret += arclen(Edge{itrs[0],itrs[1]}) * cmp;
-				break;
-			default: break;
+			if(i == p || cut[i].boundary.size() < 3) { continue; }
+			if(winding_number(cut[i].boundary, mid[p]) != 0)
+			{
+				src.push_back(i);
+			}
+		}
+		auto tree = graph::dijkstra(ws->adjacency(), src, weight);
+		ret.fp.push_back(p);
+		ret.dist.push_back(tree.dist);
+	}
+	return ret;
+}
+
+// The position in the map of the focal point closest to a segment
+uint32_t fp_near(const FPMAP& map, uint32_t s)
+{
+	uint32_t ret = -1;
+	for(uint32_t k = 0; k < map.fp.size(); k++)
+	{
+		if(map.fp[k] == s || std::isinf(map.dist[k][s])) { continue; }
+		if(ret == (uint32_t)-1 || map.dist[k][s] < map.dist[ret][s])
+		{
+			ret = k;
 		}
 	}
 	return ret;
@@ -78,125 +107,65 @@ double fp_match(Workspace* ws, Operator op)
 	// If there are no focal points we can make one 100%
 	if(fp_idx.size() == 0) { return 1.0; }
 	// Otherwise we can find the complexity / distance measure
+	FPMAP map = fp_map(ws, fp_idx);
+	uint32_t size = ws->cutSize();
 	double dis_max = 0.0;
 	double miss_sum = 0.0;
-	// A distance sum lambda
-	auto dis_sum = [=](Workspace* ws, Operator op, Segment s) -> double
-	{
-		double sum = 0.0;
-		for(auto idx : fp_idx) { sum += fp_dis(ws, op, s, idx); }
-		return sum;
-	};
-	// Get the distance for each segment
-	for(auto s : ws->cut())
+	uint32_t unreached = 0;
+	// Get the distance from each segment to its closest focal point
+	for(uint32_t i = 0; i < size; i++)
 	{
-		double dis = dis_sum(ws, op, s);
+		uint32_t k = fp_near(map, i);
+		if(k == (uint32_t)-1) { unreached++; continue; }
+		double dis = map.dist[k][i];
 		miss_sum += dis;
 		dis_max = dis > dis_max ? dis : dis_max;
 	}
+	// Segments no focal point reaches are as far as can be
+	miss_sum += unreached * dis_max;
 	// If there is only one FP and segment to be had...
 	if(dis_max == 0.0) { return 0.0; }
-	double ret = (1.0 - (miss_sum / (ws->cut().size() * dis_max)));
-	return ret;
-}
-
-std::vector<Segment> inclusion(Workspace* ws, Vertex p)
-{
-	std::vector<Segment> ret;
-	for(auto s : ws->cut())
-	{
-		int wn = winding_number(s.boundary, p);
-		if(wn != 0) { ret.push_back(s); }
-	}
+	double ret = (1.0 - (miss_sum / (size * dis_max)));
 	return ret;
 }
 
-// Focal Point Closest
-uint32_t fp_c(Workspace* ws, Operator op, std::set<uint32_t> fp, uint32_t s)
+// The segment furthest from any focal point. Segments no focal point reaches
+// come first, those in the largest component of the segment graph first.
+uint32_t fp_far(Workspace* ws, std::set<uint32_t> fp, const FPMAP& map)
 {
-	double min = -1.0;
-	uint32_t idx = -1;
-	for(auto p : fp)
-	{
-		if(p == s) { continue; }
-		double dis = fp_dis(ws, op, ws->cut()[s], p);
-		idx = min == -1.0 || dis < min ? p : idx;
-		min = min == -1.0 || dis < min ? dis : min;
-	}
-	return idx;
-}
-
-// TODO: weird that we don't need this... But it is expensive so yay?
-/*
-std::vector<std::pair<uint32_t,uint32_t>> fp_graph;
-for(auto p : cand)
-{
-	std::pair<uint32_t,uint32_t> entry
-	{
-		p, fp_c(ws, op, cand, i)
-	};
-	fp_graph.push_back(entry);
-}*/
-
-/*
-	// Check if a graph is connected
-	auto fp_connected = [=](std::vector<std::pair<uint32_t,uint32_t>> map,
-		uint32_t srt) -> bool
-	{
-		std::set<uint32_t> interior;
-		std::set<uint32_t> edge {srt};
-		while(edge.size() > 0)
-		{
-			uint32_t e = *edge.begin(); edge.erase(edge.begin());
-			if(interior.count(e)) { continue; }
-			else { interior.emplace(e); }
-			for(auto pair : map)
-			{
-				uint32_t count_s = interior.count(pair.second);
-				uint32_t count_f = interior.count(pair.first);
-				if(pair.first == e && !count_s)
-				{
-					edge.emplace(pair.second);
-				}
-				if(pair.second == e && !count_f)
-				{
-					edge.emplace(pair.first);
-				}
-			}
-		}
-		return interior.size() == map.size();
-	};
-*/
-
-// Focal Point Closest Connected
-uint32_t fp_c_c(Workspace* ws, Operator op, std::set<uint32_t> fp)
-{
-	// Find the largest connected item
+	uint32_t count = 0;
+	auto label = graph::components(ws->adjacency(), count);
+	std::vector<uint32_t> members(count, 0);
+	for(auto l : label) { members[l]++; }
 	double max = 0.0;
 	uint32_t idx = -1;
-	for(uint32_t i = 0; i < ws->cut().size(); i++)
+	for(uint32_t i = 0; i < label.size(); i++)
 	{
-		if(!fp.count(i)) { continue; }
-		double d = fp_dis(ws, op, ws->cut()[i], fp_c(ws, op, fp, i));
-		idx = d > max ? i : idx;
-		max = d > max ? d : max;
+		if(fp.count(i)) { continue; }
+		uint32_t k = fp_near(map, i);
+		double dis = k == (uint32_t)-1 ?
+			INFINITY : map.dist[k][i];
+		bool further = dis > max || (std::isinf(dis) && idx != (uint32_t)-1
+			&& members[label[i]] > members[label[idx]]);
+		idx = further ? i : idx;
+		max = further ? dis : max;
 	}
 	return idx;
 }
 
-uint32_t fp_add(Workspace* ws, Operator op, std::set<uint32_t> fp_idx)
+uint32_t fp_add(Workspace* ws, Operator op, std::set<uint32_t> fp_idx,
+	const FPMAP& map)
 {
 	// If we have no focal point add a random one
-	if(fp_idx.size() <= 0) { return int(ws->rand() * ws->cut().size()); }
-	return fp_c_c(ws, op, fp_idx);
+	if(fp_idx.size() <= 0) { return int(ws->rand() * ws->cutSize()); }
+	return fp_far(ws, fp_idx, map);
 }
 
 void fp_segment_add(Workspace* ws, Operator op, uint32_t fp_new)
 {
 	// Make a new degenerate segment in the center
-	Segment ns = ws->cut()[fp_new];
+	Segment ns = ws->cutAt(fp_new);
 	Vertex o = centroid(ns.boundary);
-	printf("FOCAL POINT AT (%f,%f)\n",o.x,o.y);
 	ws->addSegment(op, ns.layer,Polygon{o}, -1); // Add the focalpoint
 	// TODO: add links!
 }
@@ -204,25 +173,23 @@ void fp_segment_add(Workspace* ws, Operator op, uint32_t fp_new)
 void constraint_tweak(Workspace* ws, Operator op, Segment s, uint32_t fp)
 {
 	// Change orientation so it is more consistent
-	std::cout << fp << ws->cut().size() << std::endl;
-	Segment fp_seg = ws->cut()[fp];
+	Segment fp_seg = ws->cutAt(fp);
 	Vertex H = centroid(s.boundary);
 	Vertex T = centroid(fp_seg.boundary);
 	//printf("\tANGLES?!?!?\n");
 	double phi = angle({1.0,0.0}, vec(H,T));
-	auto orimatch = match_constraint("orientation", s.constraint);
-	double ori = distribution(orimatch)(ws->rand);
+	auto orimatch = match_constraint(s, cst::ORIENTATION);
+	double ori = draw(s, cst::ORIENTATION, ws->rand);
 	double tweak = 1.0 - abs(cos((phi - ori) * 2));
 	tweak = cos(phi - ori) < 0.0 ? tweak : -1.0 * tweak;
 	for(auto m : orimatch)
 	{
-		Constraint con = s.constraint[m.i];
-		double unbound = con.dial + tweak;
+		double unbound = m.dial + tweak;
 		double next = 0.0;
 		if(unbound < 0.0) { next = 1.0 + unbound; }
 		else if (unbound > 1.0) { next = -1.0 + unbound; }
 		else { next = unbound; }
-		ws->setConstraint(op, s, {{con.name, 0, 0, next}});
+		ws->setConstraint(op, s, {{cst::ORIENTATION, 0, 0, next}});
 	}
 	//printf("\t\tPHI, DIAL: %f -- %f -> %f -> %f\n",
 	//	phi, ori, cos(phi - ori), tweak);
@@ -231,7 +198,8 @@ void constraint_tweak(Workspace* ws, Operator op, Segment s, uint32_t fp)
 // Tweak the constraints on segments, assign them to new FP, basically make
 // the art piece more pleasing to a wandering eye.
 // TODO: consider other constraints?
-void constraint_tweaks(Workspace* ws, Operator op, std::set<uint32_t> fp)
+void constraint_tweaks(
+	Workspace* ws, Operator op, std::set<uint32_t> fp, const FPMAP& map)
 {
 	if(fp.size() <= 0) { return; } // Need at least one focal point
 	// Tweak the constraints around the best focal point
@@ -239,53 +207,50 @@ void constraint_tweaks(Workspace* ws, Operator op, std::set<uint32_t> fp)
 	for(auto s : ws->cut())
 	{
 		// Find the best focal point
-		uint32_t idx = fp_c(ws, op, fp, i);
+		uint32_t k = fp_near(map, i);
 		// Skip focal points and errors
 		uint32_t nocode = (uint32_t)-1;
-		if(idx == nocode || fp.count(i)) { i++; continue; }
+		if(k == nocode || fp.count(i)) { i++; continue; }
+		uint32_t idx = map.fp[k];
 		// Is there a cached focal point?
-		if(ws->op_cache[op].count(s) && ws->op_cache[op][s] != nocode)
+		if(ws->op_cache[op]->count(s) && ws->op_cache[op]->at(s) != nocode)
 		{
-			uint32_t cache_idx = ws->op_cache[op][s];
-			double dis = fp_dis(ws, op, s, idx);
-			double cache_dis = fp_dis(ws, op, s, cache_idx);
+			uint32_t cache_idx = ws->op_cache[op]->at(s);
+			auto cached = std::find(map.fp.begin(), map.fp.end(), cache_idx);
+			double dis = map.dist[k][i];
+			double cache_dis = cached == map.fp.end() ?
+				INFINITY : map.dist[cached - map.fp.begin()][i];
 			// Decide if cache needs to change
 			// TODO: fiddle with this?
 			if(cache_dis * 0.8 < dis) { idx = cache_idx; }
 		}
 		constraint_tweak(ws, op, s, idx); // Do the actuall tweaks
-		ws->op_cache[op][s] = idx; // Update cache
+		ws->op_cache[op].edit()[s] = idx; // Update cache
 		i++; // Update the index counter
 	}
 }
 
 void fplambda(Workspace* ws, Operator op)
 {
-	printf("FOCAL POINTS...\n");
 	std::set<uint32_t> fp_idx = fp_indexes(ws, op);
 
 	//printf("\tNUM FOCAL POINTS: %i\n", fp_idx.size());
 
-	uint32_t fp_new = fp_add(ws, op, fp_idx);
+	// Distances are measured before the new focal point joins the cut
+	FPMAP map = fp_map(ws, fp_idx);
+	uint32_t fp_new = fp_add(ws, op, fp_idx, map);
 	if(fp_new != (uint32_t)-1) { fp_segment_add(ws, op, fp_new); }
 	// Tweak constraints to make them better!
-	constraint_tweaks(ws, op, fp_idx);
+	constraint_tweaks(ws, op, fp_idx, map);
 }
 
-Callback focal(Workspace* ws, Operator op)
+Score focal_score(Workspace* ws, const Operator& op)
 {
 	// TODO: make a distance map to send to fp_match and bind to fplambda!
 		// This is a factor 2 speedup
-	// TODO: make a connectivity graph of segments in plane, attach to WS
-		// This is a factor N**2 -> log(N) speedup
 	// TODO: PALETTE TWEAKS! - Make palettes more bold close to a FP!
 	double match = fp_match(ws, op);
-	Callback ret
-	{
-		.usable = match != 0.0,
-		.match = match,
-		.priority = 1.0,
-		.callback = [=]() mutable -> void { fplambda(ws, op); }
-	};
-	return ret;
+	return {match != 0.0, match, 1.0};
 }
+
+void focal(Workspace* ws, const Operator& op) { fplambda(ws, op); }
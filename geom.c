@@ -368,6 +368,30 @@ bool geom::on_edge(Edge e, Vertex v)
 	return false;
 }
 
+bool geom::overlap(Edge a, Edge b)
+{
+	double len = arclen(a);
+	if(len <= EPS) { return false; }
+	Vector dir = scale(vec(a.head,a.tail), 1.0 / len);
+	// Both ends of b must lie on the line through a
+	Vector h = vec(a.head,b.head);
+	Vector t = vec(a.head,b.tail);
+	if(fabs(cross(dir,h)) > EPS || fabs(cross(dir,t)) > EPS) { return false; }
+	// And their projections must overlap a by more than a point
+	double lo = fmax(0.0, fmin(dot(dir,h), dot(dir,t)));
+	double hi = fmin(len, fmax(dot(dir,h), dot(dir,t)));
+	return hi - lo > EPS;
+}
+
+bool geom::share_edge(Polygon a, Polygon b)
+{
+	for(auto ea : edgeThunk(a))
+	{
+		for(auto eb : edgeThunk(b)) { if(overlap(ea,eb)) { return true; } }
+	}
+	return false;
+}
+
 bool geom::on_edge(Polygon p, Vertex v)
 {
 	for(auto e : edgeThunk(p)) { if(on_edge(e,v)) { return true; }}
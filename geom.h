@@ -87,6 +87,9 @@ namespace geom
 	bool interior(Polygon, Vertex);
 	bool interior(Polygon, Polygon);
 	bool interior(Polygon, Polygon, bool);
+	// Collinear edges overlapping by more than a point
+	bool overlap(Edge, Edge);
+	bool share_edge(Polygon, Polygon);
 	// Inclosure
 	double dirangle(Edge, Vertex);
 	double dirangle(Vertex, Vertex, Vertex);
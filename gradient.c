@@ -4,12 +4,11 @@
 
 // C++ imports
 #include <vector>
-#include <deque>
-#include <set>
 #include <map>
 
 // module imports
 #include "geom.h"
+#include "graph.h"
 #include "render.h"
 #include "operators.h"
 #include "constraints.h"
@@ -29,13 +28,14 @@ union GRAD
 
 GRAD gradCacheGet(Workspace* ws, Operator op, Segment s)
 {
-	if(ws->op_cache[op].count(s)) { return {.word = ws->op_cache[op][s]}; }
+	const auto& marks = *ws->op_cache[op];
+	if(marks.count(s)) { return {.word = marks.at(s)}; }
 	return {.word = (uint32_t)-1};
 }
 
 void gradCacheSet(Workspace* ws, Operator op, Segment s, GRAD g)
 {
-	ws->op_cache[op][s] = g.word;
+	ws->op_cache[op].edit()[s] = g.word;
 }
 
 std::map<uint64_t,GRAPH> readGrads(Workspace* ws, Operator op) {
@@ -51,75 +51,47 @@ std::map<uint64_t,GRAPH> readGrads(Workspace* ws, Operator op) {
 	return ret;
 }
 
-// Full link graph creation with MST ect. Use djkstra for MST.
-struct DIJKSTRAS_RET { GRAPH link; GRAPH mst; uint64_t span; };
+// The breadth-first tree of the segment graph and its depth
+struct DIJKSTRAS_RET { graph::Tree tree; graph::CSR mst; uint64_t span; };
 DIJKSTRAS_RET linkGraph(Workspace* ws)
 {
-	// The return struct things
-	GRAPH mst;
-	GRAPH lnk;
+	// Hop counts from the first segment, edges are all the same length
+	graph::Tree tree = graph::bfs(ws->adjacency(), 0);
 	uint64_t max = 0;
-
-	// Make ID map
-	int i = 0;
-	std::map<Segment,uint64_t> id;
-	for(auto s : ws->cut()) { id[s] = i; i++; }
-
-	// Do djkstras algorithm for graph and MST
-	std::map<uint64_t,uint64_t> dijkstra; dijkstra[0] = 0;
-	std::deque<uint64_t> leaf {0};
-	std::set<uint64_t> core;
-	while(leaf.size() > 0)
+	for(auto n : tree.order)
 	{
-		uint64_t next = leaf.front(); leaf.pop_front();
-		core.insert(next);
-		/* TODO: FIX!
-		for(auto l : ws->cut()[next].geom)
-		{
-			uint64_t link = id[l];
-			lnk.push_back({next,link});
-			// If we bump into another leaf set the span
-			if(!dijkstra.count(link))
-			{
-				uint64_t span = dijkstra[next]+1;
-				max = span > max ? span : max;
-				dijkstra[link] = span;
-				mst.push_back({next,link});
-				leaf.push_back(link);
-			}
-		}
-		*/
+		uint64_t span = tree.dist[n];
+		max = span > max ? span : max;
 	}
-	return {lnk,mst,max};
+	return {tree, graph::children(tree), max};
 }
 
-std::string grdcon(Workspace* ws, Operator op, GRAPH graph)
+// The key of the gradient constraint, none if the operator has no keys
+uint32_t grdcon(Workspace* ws, const Operator& op, GRAPH graph)
 {
 	// Find the gradient constraint
 	double dis = -1.0;
-	std::string constraint;
-	for(auto con : op.cons)
+	uint32_t constraint = (uint32_t)-1;
+	for(auto key : op.cons)
 	{
 		double min = -1.0;
 		double max = -1.0;
 		for(auto edge : graph)
 		{
 			uint64_t id = (uint64_t)edge.first;
-			auto cons = ws->cut()[id].constraint;
-			auto match = match_constraint(con, cons);
-			double val = distribution(match)(ws->rand);
+			double val = draw(ws->cutAt(id), key, ws->rand);
 			max = (max == -1.0 || val > max) ? val : max;
 			min = (min == -1.0 || val < max) ? val : min;
 		}
 		double diff = max - min;
 		dis = (dis == -1.0 || diff > dis) ? diff : dis;
-		if(dis == diff) { constraint = con; }
+		if(dis == diff) { constraint = key; }
 	}
 	return constraint;
 }
 
 struct GRAPHSTAT { double min; double max; double minC; double maxC; double s;};
-GRAPHSTAT graph_stats(Workspace* ws, Operator op, std::string c, GRAPH graph)
+GRAPHSTAT graph_stats(Workspace* ws, Operator op, uint32_t key, GRAPH graph)
 {
 	double min = -1.0;
 	double max = -1.0;
@@ -129,8 +101,7 @@ GRAPHSTAT graph_stats(Workspace* ws, Operator op, std::string c, GRAPH graph)
 	for(auto g : graph)
 	{
 		uint16_t id = g.second;
-		auto match = match_constraint(c, ws->cut()[id].constraint);
-		double val = distribution(match)(ws->rand);
+		double val = draw(ws->cutAt(id), key, ws->rand);
 		min = (min == -1.0 || val < min) ? val : min;
 		max = (max == -1.0 || val > max) ? val : max;
 		if(min == val) { minC = count; } 
@@ -176,17 +147,15 @@ double grdmatch(Workspace* ws, Operator op, std::map<uint64_t,GRAPH> gradient)
 	// Eval all gradients
 	for(auto grad : gradient)
 	{
-		std::string constraint = grdcon(ws, op, grad.second);
-		GRAPHSTAT stat = graph_stats(ws, op, constraint, grad.second);
+		uint32_t key = grdcon(ws, op, grad.second);
+		GRAPHSTAT stat = graph_stats(ws, op, key, grad.second);
 		// Evaluate the constraint by finding the SD of differences
 		std::vector<double> diff;
 		double count = 0.0;
 		for(auto edge : grad.second)
 		{
 			uint32_t id = edge.second;
-			auto cons = ws->cut()[id].constraint;
-			auto match = match_constraint(constraint, cons);
-			double val = distribution(match)(ws->rand);
+			double val = draw(ws->cutAt(id), key, ws->rand);
 			double tgt = edge_target(count, stat);
 			diff.push_back(val - tgt);
 			count += 1.0;
@@ -207,16 +176,16 @@ void update_chains( Workspace* ws, Operator op, std::map<uint64_t,GRAPH> grad)
 		bool bigger = (max == (uint16_t)-1 || graph.first > max);
 		max = bigger ? graph.first : max;
 		// Tweak the constraints
-		std::string cons = grdcon(ws, op, graph.second);
-		GRAPHSTAT stat = graph_stats(ws, op, cons, graph.second);
+		uint32_t key = grdcon(ws, op, graph.second);
+		GRAPHSTAT stat = graph_stats(ws, op, key, graph.second);
 		// Now that we know the statistics we want to update stuff
 		double count = 0.0;
 		for(auto g : graph.second)
 		{
 			double target = edge_target(count, stat);
 			uint32_t id = g.second;
-			Segment seg = ws->cut()[id];
-			for(auto m : match_constraint(cons, seg.constraint))
+			const Segment& seg = ws->cutAt(id);
+			for(auto m : match_constraint(seg, key))
 			{
 				double diff = target - m.dial;
 				double low = m.dial;
@@ -226,8 +195,7 @@ void update_chains( Workspace* ws, Operator op, std::map<uint64_t,GRAPH> grad)
 					m.dial +
 					(scale * diff * 0.3);
 				
-				Constraint c = seg.constraint[m.i];
-				ws->setConstraint(op, seg, {{c.name, 0, 0, update}});
+				ws->setConstraint(op, seg, {{key, 0, 0, update}});
 			}
 			count += 1.0;
 		}
@@ -236,33 +204,13 @@ void update_chains( Workspace* ws, Operator op, std::map<uint64_t,GRAPH> grad)
 
 GRAPH find_chain(Workspace* ws, DIJKSTRAS_RET dijk)
 {
-	uint16_t place = ws->rand() * (ws->cut().size() - 1);
+	// Walk down the MST from a random segment until reaching a leaf
+	uint16_t place = ws->rand() * (ws->cutSize() - 1);
+	auto path = graph::walk(dijk.mst, place, graph::nodes(dijk.mst), ws->rand);
 	GRAPH cand;
-	while(true)
+	for(uint32_t i = 1; i < path.size(); i++)
 	{
-		// Find all connections
-		std::vector<uint16_t> leaf;
-		for(auto s : dijk.mst)
-		{
-			if(s.first != place) { continue; }
-			uint16_t e = s.second;
-			bool breaker = true;
-			for(auto edge : cand)
-			{
-				if(e == edge.first || e == edge.second)
-				{
-					breaker = false;
-					break;
-				}
-			}
-			if(breaker) { leaf.push_back(e); }
-		}
-		if(leaf.size() == 0) { break; }
-		// Choose random leaf from MST
-		uint64_t rnd = ws->rand() * (leaf.size() - 1);
-		uint16_t next = leaf[rnd];
-		cand.push_back({place, next});
-		place = next;
+		cand.push_back({path[i-1], path[i]});
 	}
 	return cand;
 }
@@ -271,7 +219,6 @@ void grdlambda(
 	Workspace* ws, Operator op,
 	std::map<uint64_t,GRAPH> gradient, DIJKSTRAS_RET dijk)
 {
-	printf("GRADIENT...\n");
 	// Update chains
 	update_chains(ws, op, gradient); //TODO: RETURN thingy!
 	// Use the MST to find a chain
@@ -284,26 +231,21 @@ void grdlambda(
 	for(auto g : cand)
 	{
 		GRAD grd; grd.id = max + 1; grd.pt = g.second;
-		gradCacheSet(ws, op, ws->cut()[g.first], grd);
+		gradCacheSet(ws, op, ws->cutAt(g.first), grd);
 	}
 }
 
-Callback gradient(Workspace* ws, Operator op)
+Score gradient_score(Workspace* ws, const Operator& op)
 {
 	// Graph of previous gradients
 	std::map<uint64_t,GRAPH> grd = readGrads(ws, op);
 	// Full segment connectivity graph
 	auto dijk = linkGraph(ws);
+	//TODO: maybe 2 is better here?
+	return {dijk.span > 1, grdmatch(ws, op, grd), 1.0};
+}
 
-	Callback ret
-	{
-		.usable = (dijk.span > 1), //TODO: maybe 2 is better here?
-		.match = grdmatch(ws, op, grd),
-		.priority = 1.0,
-		.callback = [=]() mutable -> void
-		{
-			grdlambda(ws, op, grd, dijk);
-		}
-	};
-	return ret;
+void gradient(Workspace* ws, const Operator& op)
+{
+	grdlambda(ws, op, readGrads(ws, op), linkGraph(ws));
 }
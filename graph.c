@@ -0,0 +1,240 @@
+// C++ imports
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <limits>
+
+// Module imports
+#include "graph.h"
+
+graph::CSR graph::build(uint32_t nodes, std::vector<Link> links)
+{
+	// Store every link both ways, sorted by node then neighbour
+	std::vector<Link> both;
+	both.reserve(links.size() * 2);
+	for(auto l : links)
+	{
+		if(l.first == l.second) { continue; }
+		both.push_back(l);
+		both.push_back({l.second, l.first});
+	}
+	std::sort(both.begin(), both.end());
+	both.erase(std::unique(both.begin(), both.end()), both.end());
+	CSR ret;
+	ret.start.assign(nodes + 1, 0);
+	for(auto l : both) { ret.start[l.first + 1]++; }
+	for(uint32_t i = 0; i < nodes; i++) { ret.start[i+1] += ret.start[i]; }
+	for(auto l : both) { ret.edge.push_back(l.second); }
+	return ret;
+}
+
+uint32_t graph::nodes(const CSR& g)
+{
+	return g.start.size() == 0 ? 0 : g.start.size() - 1;
+}
+
+graph::Range graph::neighbours(const CSR& g, uint32_t node, uint32_t base)
+{
+	if(node >= nodes(g)) { return Range(); }
+	const uint32_t* data = g.edge.data();
+	return Range(data + g.start[node], data + g.start[node+1], base);
+}
+
+bool graph::linked(const CSR& g, uint32_t a, uint32_t b)
+{
+	if(a >= nodes(g)) { return false; }
+	auto first = g.edge.begin() + g.start[a];
+	auto last = g.edge.begin() + g.start[a+1];
+	return std::binary_search(first, last, b);
+}
+
+// An empty tree over all nodes, to be filled in by a search
+graph::Tree unreached(const graph::CSR& g)
+{
+	uint32_t n = graph::nodes(g);
+	graph::Tree ret;
+	ret.parent.assign(n, graph::NONE);
+	ret.root.assign(n, graph::NONE);
+	ret.dist.assign(n, std::numeric_limits<double>::infinity());
+	ret.order.reserve(n);
+	return ret;
+}
+
+graph::Tree graph::bfs(const CSR& g, uint32_t root)
+{
+	Tree ret = unreached(g);
+	if(root >= nodes(g)) { return ret; }
+	// The order doubles as the frontier queue
+	ret.root[root] = root;
+	ret.dist[root] = 0.0;
+	ret.order.push_back(root);
+	for(uint32_t i = 0; i < ret.order.size(); i++)
+	{
+		uint32_t u = ret.order[i];
+		for(auto v : neighbours(g, u))
+		{
+			if(ret.root[v] != NONE) { continue; }
+			ret.parent[v] = u;
+			ret.root[v] = root;
+			ret.dist[v] = ret.dist[u] + 1.0;
+			ret.order.push_back(v);
+		}
+	}
+	return ret;
+}
+
+// Best-first search shared by Dijkstra and Prim, which only differ in what
+// a node is keyed by: the path length to it or the last link to it.
+graph::Tree best_first(
+	const graph::CSR& g,
+	const std::vector<uint32_t>& sources,
+	graph::Weight weight,
+	bool path)
+{
+	using Entry = std::pair<double,uint32_t>;
+	graph::Tree ret = unreached(g);
+	std::vector<bool> done(graph::nodes(g), false);
+	std::priority_queue<Entry,std::vector<Entry>,std::greater<Entry>> heap;
+	for(auto s : sources)
+	{
+		if(s >= graph::nodes(g) || ret.root[s] != graph::NONE) { continue; }
+		ret.root[s] = s;
+		ret.dist[s] = 0.0;
+		heap.push({0.0, s});
+	}
+	while(heap.size() > 0)
+	{
+		auto [d, u] = heap.top(); heap.pop();
+		// Stale entries are left in the heap rather than decreased
+		if(done[u] || d > ret.dist[u]) { continue; }
+		done[u] = true;
+		ret.order.push_back(u);
+		for(auto v : graph::neighbours(g, u))
+		{
+			if(done[v]) { continue; }
+			double key = weight(u, v) + (path ? d : 0.0);
+			if(!(key < ret.dist[v])) { continue; }
+			ret.parent[v] = u;
+			ret.root[v] = ret.root[u];
+			ret.dist[v] = key;
+			heap.push({key, v});
+		}
+	}
+	return ret;
+}
+
+graph::Tree graph::dijkstra(
+	const CSR& g, const std::vector<uint32_t>& sources, Weight weight)
+{
+	return best_first(g, sources, weight, true);
+}
+
+graph::Tree graph::mst(const CSR& g, uint32_t root, Weight weight)
+{
+	return best_first(g, {root}, weight, false);
+}
+
+graph::CSR graph::children(const Tree& t)
+{
+	// Counting sort of nodes by parent keeps the children sorted by id
+	CSR ret;
+	uint32_t n = t.parent.size();
+	ret.start.assign(n + 1, 0);
+	for(auto p : t.parent) { if(p != NONE) { ret.start[p + 1]++; } }
+	for(uint32_t i = 0; i < n; i++) { ret.start[i+1] += ret.start[i]; }
+	ret.edge.resize(ret.start[n]);
+	std::vector<uint32_t> at(ret.start.begin(), ret.start.end() - 1);
+	for(uint32_t v = 0; v < n; v++)
+	{
+		if(t.parent[v] != NONE) { ret.edge[at[t.parent[v]]++] = v; }
+	}
+	return ret;
+}
+
+std::vector<uint32_t> graph::components(const CSR& g, uint32_t& count)
+{
+	uint32_t n = nodes(g);
+	std::vector<uint32_t> label(n, NONE);
+	std::vector<uint32_t> queue;
+	queue.reserve(n);
+	count = 0;
+	for(uint32_t s = 0; s < n; s++)
+	{
+		if(label[s] != NONE) { continue; }
+		queue.clear();
+		queue.push_back(s);
+		label[s] = count;
+		for(uint32_t i = 0; i < queue.size(); i++)
+		{
+			for(auto v : neighbours(g, queue[i]))
+			{
+				if(label[v] != NONE) { continue; }
+				label[v] = count;
+				queue.push_back(v);
+			}
+		}
+		count++;
+	}
+	return label;
+}
+
+graph::Groups::Groups(uint32_t nodes) { grow(nodes); }
+
+void graph::Groups::grow(uint32_t nodes)
+{
+	for(uint32_t i = up.size(); i < nodes; i++)
+	{
+		up.push_back(i);
+		count.push_back(1);
+		ring.push_back(i);
+	}
+}
+
+uint32_t graph::Groups::find(uint32_t node)
+{
+	while(up[node] != node)
+	{
+		up[node] = up[up[node]];
+		node = up[node];
+	}
+	return node;
+}
+
+bool graph::Groups::join(uint32_t a, uint32_t b)
+{
+	uint32_t ra = find(a);
+	uint32_t rb = find(b);
+	if(ra == rb) { return false; }
+	if(count[ra] < count[rb]) { std::swap(ra, rb); }
+	up[rb] = ra;
+	count[ra] += count[rb];
+	// Swapping successors splices the two rings into one
+	std::swap(ring[a], ring[b]);
+	return true;
+}
+
+bool graph::Groups::same(uint32_t a, uint32_t b) { return find(a) == find(b); }
+uint32_t graph::Groups::size(uint32_t node) { return count[find(node)]; }
+
+std::vector<uint32_t> graph::Groups::members(uint32_t node) const
+{
+	std::vector<uint32_t> ret {node};
+	for(uint32_t n = ring[node]; n != node; n = ring[n]) { ret.push_back(n); }
+	return ret;
+}
+
+std::vector<uint32_t> graph::walk(
+	const CSR& g, uint32_t start, uint32_t steps, rng::Random& rand)
+{
+	std::vector<uint32_t> ret;
+	if(start >= nodes(g)) { return ret; }
+	ret.push_back(start);
+	for(uint32_t i = 0; i < steps; i++)
+	{
+		Range next = neighbours(g, ret.back());
+		if(next.size() == 0) { break; }
+		uint32_t pick = rand() * next.size();
+		ret.push_back(next[pick < next.size() ? pick : next.size() - 1]);
+	}
+	return ret;
+}
@@ -0,0 +1,105 @@
+// C++ imports
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+
+// Module imports
+#include "random.h"
+
+#ifndef graph_h
+#define graph_h
+namespace graph
+{
+	// A view of a run of node ids, each offset by a base id. It reads the
+	// graph in place, so it is only valid until the graph changes.
+	class Range
+	{
+		const uint32_t* first;
+		const uint32_t* last;
+		uint32_t base;
+		public:
+			class iterator
+			{
+				const uint32_t* at;
+				uint32_t base;
+				public:
+					iterator(const uint32_t* a, uint32_t b) : at{a}, base{b} {};
+					uint32_t operator*() const { return *at + base; }
+					iterator& operator++() { at++; return *this; }
+					bool operator!=(const iterator& o) const { return at != o.at; }
+			};
+			Range() : first{NULL}, last{NULL}, base{0} {};
+			Range(const uint32_t* f, const uint32_t* l, uint32_t b) :
+				first{f}, last{l}, base{b} {};
+			iterator begin() const { return iterator(first, base); }
+			iterator end() const { return iterator(last, base); }
+			uint32_t size() const { return last - first; }
+			uint32_t operator[](uint32_t i) const { return first[i] + base; }
+	};
+
+	// An undirected graph in compressed sparse rows. The neighbours of node
+	// i are edge[start[i]] up to edge[start[i+1]], sorted by id.
+	typedef struct csr
+	{
+		std::vector<uint32_t> start;
+		std::vector<uint32_t> edge;
+	} CSR;
+
+	typedef std::pair<uint32_t,uint32_t> Link;
+
+	// A graph of a number of nodes from links, in either direction
+	CSR build(uint32_t nodes, std::vector<Link> links);
+	uint32_t nodes(const CSR&);
+	Range neighbours(const CSR&, uint32_t node, uint32_t base = 0);
+	bool linked(const CSR&, uint32_t a, uint32_t b);
+
+	// Marks no node, the parent of roots and the root of unreached nodes
+	const uint32_t NONE = (uint32_t)-1;
+	typedef std::function<double(uint32_t,uint32_t)> Weight;
+
+	// A search tree over a graph. Nodes appear in order of increasing
+	// distance, so runs of equal distance in a search are its BFS layers.
+	typedef struct tree
+	{
+		std::vector<uint32_t> parent;
+		std::vector<uint32_t> root;
+		std::vector<double> dist;
+		std::vector<uint32_t> order;
+	} Tree;
+
+	// Hop counts from a root, only its component is reached
+	Tree bfs(const CSR&, uint32_t root);
+	// Weighted distances from the nearest of many sources
+	Tree dijkstra(const CSR&, const std::vector<uint32_t>& sources, Weight);
+	// Prim's tree of a root's component, dist is the weight to the parent
+	Tree mst(const CSR&, uint32_t root, Weight);
+	// The tree as a graph of links from each parent to its children
+	CSR children(const Tree&);
+	// A component label for each node, counted from zero
+	std::vector<uint32_t> components(const CSR&, uint32_t& count);
+	// Disjoint groups of nodes under union by size with path halving, so
+	// joining and testing are near constant time. Each group also keeps its
+	// members in a ring, so listing one costs only its size.
+	class Groups
+	{
+		std::vector<uint32_t> up;
+		std::vector<uint32_t> count;
+		std::vector<uint32_t> ring;
+		public:
+			Groups(uint32_t nodes = 0);
+			// Add nodes up to a total, each in a group of its own
+			void grow(uint32_t nodes);
+			uint32_t find(uint32_t node);
+			// Join the groups of two nodes, false if already one group
+			bool join(uint32_t a, uint32_t b);
+			bool same(uint32_t a, uint32_t b);
+			uint32_t size(uint32_t node);
+			std::vector<uint32_t> members(uint32_t node) const;
+	};
+	// The nodes of a uniform random walk from start, ending early at a node
+	// with no links
+	std::vector<uint32_t> walk(
+		const CSR&, uint32_t start, uint32_t steps, rng::Random&);
+};
+#endif
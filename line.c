@@ -7,7 +7,6 @@
 
 
 // module imports
-#include <cairo.h>
 #include "palette.h"
 #include "render.h"
 #include "brushes.h"
@@ -23,22 +22,23 @@ typedef struct linestate
 } LINE_STATE;
 
 // Matching code!
-double line_number(Workspace* ws, Segment s, LINE_STATE state)
+double line_number(Workspace* ws, const Segment& s, const LINE_STATE& state)
 {
 	// Decide the number of lines, depending on number of neighbors
 	double area = abs(signed_area(s.boundary));
 	area = area < 1.0 ? 1.0 : area;
 	double N = ((s.scale * state.cmp) / (area * state.siz));
 	// Get the number of neighbors
-	uint32_t neighbors = ws->geomRel(s).size();
+	uint32_t neighbors = ws->neighbours(s).size();
 	/*
 	if(neighbors < N)
 	{
 		printf("NEIGHBORS %d\n\t",neighbors);
 		printf("CENTERS");
-		for(auto n : ws->geomRel(s))
+		for(auto n : ws->neighbours(s))
 		{
-			printf("(%f,%f) ",geom::midpoint(n.boundary).x,geom::midpoint(n.boundary).y);
+			Polygon b = ws->cutAt(n).boundary;
+			printf("(%f,%f) ",geom::midpoint(b).x,geom::midpoint(b).y);
 		}
 		printf("\n");
 		return neighbors;
@@ -50,21 +50,13 @@ double line_number(Workspace* ws, Segment s, LINE_STATE state)
 std::vector<uint64_t> marked_ids(Workspace* ws, Brush b)
 {
 	std::vector<uint64_t> ret;
-	std::vector<Segment> seg = ws->cut();
-	for(uint32_t i = 0; i < seg.size(); i++)
+	for(uint32_t i = 0; i < ws->cutSize(); i++)
 	{
-		if(ws->br_cache[b].count(seg[i])) { ret.push_back(i); }
+		if(ws->br_cache[b].count(ws->cutAt(i))) { ret.push_back(i); }
 	}
 	return ret;
 }
 
-std::vector<Segment> vecThunk(std::set<Segment> item)
-{
-	std::vector<Segment> ret = {};
-	for(auto i : item) { ret.push_back(i); }
-	return ret;
-}
-
 // Some brushes!
 void linelambda(Workspace* ws, Segment sg, LINE_STATE s)
 {
@@ -74,65 +66,63 @@ void linelambda(Workspace* ws, Segment sg, LINE_STATE s)
 	// Add a new vertex if there is enough complexity to justify it
 	if(next < line_number(ws, sg, s)) { ws->br_cache[s.brush][sg] = next; }
 	else { return; }
-	// Draw another line if there are enough matches to justify them
+	// Draw another line if there is a neighbour left to draw it to
+	graph::Range near = ws->neighbours(sg);
+	if(next > near.size()) { return; }
 	auto start = geom::centroid(sg.boundary);
-	auto end = geom::centroid(vecThunk(ws->geomRel(sg))[next-1].boundary);
+	auto end = geom::centroid(ws->cutAt(near[next-1]).boundary);
 
-	cairo_t* drawer = cairo_create(sg.canvas);
 	double size = s.siz * 10.0;
 	//double area = abs(signed_area(sg.boundary));
 	size = size < 1.0 ? 1.0 : size;
 
 	Color c = s.color;
-	cairo_set_line_width(drawer, size);
-	cairo_set_source_rgba(drawer, c.red, c.green, c.blue, 1.0);
-	cairo_move_to(drawer, ws->scale() * start.x, ws->scale() * start.y);
-	cairo_line_to(drawer, ws->scale() * end.x, ws->scale() * end.y);
-	cairo_stroke(drawer);
-	cairo_destroy(drawer);
+	Polygon stroke = {
+		geom::scale(start, ws->scale()),
+		geom::scale(end, ws->scale())};
+	sg.record->stroke(stroke, size, color_source(c, 1.0));
 }
 
-Callback line(Workspace* ws, Segment s, Brush b)
+Score line_score(Workspace* ws, const Segment& s, const Brush& b)
+{
+	// Estimate the number of lines from one draw of the dials
+	LINE_STATE state;
+	state.siz = draw(s, cst::SIZE, ws->rand);
+	state.cmp = draw(s, cst::COMPLEXITY, ws->rand);
+
+	// Find the match
+	double N = line_number(ws, s, state);
+	double match = N <= 0.0 ? 0.0 : (1.0 / (1.0 + log(N)));
+	return {match != 0.0 ? true : false, match, b.priority};
+}
+
+std::function<void()> line(Workspace* ws, const Segment& s, const Brush& b)
 {
 	// Ensure the cache is constructed
 	// ensure_cache(ws, b);
 	// Pick the line(s) palette
 	uint32_t palette_mask = 0;
-	for(auto m : match_constraint("palette",s.constraint))
+	for(auto m : match_constraint(s, cst::PALETTE))
 	{
 		palette_mask |= m.mask;
 	}
 	Palette palette = pick_palette(ws, palette_mask);
-	Color color = pick_color(ws, &palette, s.constraint);
+	Color color = pick_color(ws, &palette);
 
 	// Create the costate for the lambda
-	auto sizmatch = match_constraint("size",s.constraint);
-	auto cmpmatch = match_constraint("complexity",s.constraint);
-	auto orimatch = match_constraint("orientation", s.constraint);
 
 	LINE_STATE state = 
 	{
 		.brush = b,
 		.color = color,
-		.siz = distribution(sizmatch)(ws->rand),
-		.cmp = distribution(cmpmatch)(ws->rand),
-		.ori = distribution(orimatch)(ws->rand)
+		.siz = draw(s, cst::SIZE, ws->rand),
+		.cmp = draw(s, cst::COMPLEXITY, ws->rand),
+		.ori = draw(s, cst::ORIENTATION, ws->rand)
 	};
-
-	// Find the match
-	double N = line_number(ws, s, state);
-	double match = N <= 0.0 ? 0.0 : (1.0 / (1.0 + log(N)));
-
-	Callback ret
+	Segment sg = s;
+	return [=]() -> void
 	{
-		.usable = match != 0.0 ? true : false,
-		.match = match,
-		.priority = b.priority,
-		.callback = [=]() mutable -> void
-		{
-			//printf("Drawing Line...\n");
-			linelambda(ws, s, state);
-		}
+		//printf("Drawing Line...\n");
+		linelambda(ws, sg, state);
 	};
-	return ret;
 }
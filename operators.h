@@ -4,10 +4,15 @@
 #ifndef operators_h
 #define operators_h
 
-Callback symmetry(Workspace*, Operator);
-Callback figureandground(Workspace*, Operator);
-Callback gradient(Workspace*, Operator);
-Callback focal(Workspace*, Operator);
+// Each operator scores the workspace cheaply, and lays out when chosen
+Score symmetry_score(Workspace*, const Operator&);
+Score figureandground_score(Workspace*, const Operator&);
+Score gradient_score(Workspace*, const Operator&);
+Score focal_score(Workspace*, const Operator&);
+void symmetry(Workspace*, const Operator&);
+void figureandground(Workspace*, const Operator&);
+void gradient(Workspace*, const Operator&);
+void focal(Workspace*, const Operator&);
 
 static Operator symmetry_operator
 {
@@ -17,6 +22,7 @@ static Operator symmetry_operator
 		"complexity",
 		"orientation"
 	},
+	.score = symmetry_score,
 	.layout = symmetry
 };
 
@@ -28,6 +34,7 @@ static Operator figure_and_ground_operator
 		"complexity",
 		"size"
 	},
+	.score = figureandground_score,
 	.layout = figureandground
 };
 
@@ -39,6 +46,7 @@ static Operator focal_point_operator
 		"complexity",
 		"orientation"
 	},
+	.score = focal_score,
 	.layout = focal
 };
 
@@ -52,6 +60,7 @@ static Operator gradient_operator
 		"size",
 		"palette"
 	},
+	.score = gradient_score,
 	.layout = gradient
 };
 #endif
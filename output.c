@@ -0,0 +1,229 @@
+// C imports
+#include <stdio.h>
+#include <cairo.h>
+#include <cairo-svg.h>
+#include <cairo-pdf.h>
+#include <zlib.h>
+
+// C++ imports
+#include <string>
+#include <vector>
+
+// Module imports
+#include "output.h"
+
+bool out::backend(std::string name, BACKEND &ret)
+{
+	if(name == "svg") { ret = BACKEND::SVG; return true; }
+	if(name == "pdf") { ret = BACKEND::PDF; return true; }
+	if(name == "png") { ret = BACKEND::PNG; return true; }
+	if(name == "rgba") { ret = BACKEND::RGBA; return true; }
+	return false;
+}
+
+std::string out::name(BACKEND type)
+{
+	switch(type)
+	{
+		case BACKEND::SVG: return "svg";
+		case BACKEND::PDF: return "pdf";
+		case BACKEND::PNG: return "png";
+		case BACKEND::RGBA: return "rgba";
+	}
+	return "";
+}
+
+out::Output::Output(BACKEND b, std::string filename, uint32_t width, uint32_t height)
+{
+	type = b;
+	file = filename;
+	w = width;
+	h = height;
+	rows = 0;
+	png = NULL;
+	switch(type)
+	{
+		case BACKEND::SVG:
+			canvas = cairo_svg_surface_create(file.c_str(), w, h);
+			cairo_svg_surface_restrict_to_version(
+				canvas, CAIRO_SVG_VERSION_1_2);
+			cairo_svg_surface_set_document_unit(canvas, CAIRO_SVG_UNIT_PX);
+			break;
+		case BACKEND::PDF:
+			canvas = cairo_pdf_surface_create(file.c_str(), w, h);
+			break;
+		case BACKEND::PNG:
+		case BACKEND::RGBA:
+			canvas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+			break;
+	}
+}
+
+// Cairo stores premultiplied native endian ARGB words, PNG wants straight RGBA
+static void straight(const uint32_t* row, uint8_t* dst, uint32_t w)
+{
+	for(uint32_t x = 0; x < w; x++, dst += 4)
+	{
+		uint32_t px = row[x];
+		uint32_t a = (px >> 24) & 0xFF;
+		uint32_t c[3] = {(px >> 16) & 0xFF, (px >> 8) & 0xFF, px & 0xFF};
+		for(int i = 0; i < 3; i++)
+		{
+			dst[i] = a == 0 ? 0 : (c[i] * 255 + a / 2) / a;
+		}
+		dst[3] = a;
+	}
+}
+
+// The open file, the deflate stream over all scanlines and the rows so far
+struct out::pngstream
+{
+	FILE* file;
+	z_stream zip;
+	std::vector<uint8_t> line;
+	std::vector<uint8_t> chunk;
+	uint32_t done;
+	bool ok;
+};
+
+static void put32(std::vector<uint8_t>& buf, uint32_t v)
+{
+	for(int i = 3; i >= 0; i--) { buf.push_back((v >> (8 * i)) & 0xFF); }
+}
+
+static bool png_chunk(FILE* f, const char* kind, const uint8_t* data, uint32_t n)
+{
+	std::vector<uint8_t> head;
+	put32(head, n);
+	head.insert(head.end(), kind, kind + 4);
+	uLong crc = crc32(0L, (const Bytef*)kind, 4);
+	if(n > 0) { crc = crc32(crc, data, n); }
+	std::vector<uint8_t> tail;
+	put32(tail, crc);
+	return fwrite(head.data(), 1, 8, f) == 8
+		&& (n == 0 || fwrite(data, 1, n, f) == n)
+		&& fwrite(tail.data(), 1, 4, f) == 4;
+}
+
+// Deflate what is pending, writing an IDAT whenever the chunk buffer fills
+static bool png_deflate(out::pngstream* p, int flush)
+{
+	int ret = Z_OK;
+	do
+	{
+		p->zip.next_out = p->chunk.data();
+		p->zip.avail_out = p->chunk.size();
+		ret = deflate(&p->zip, flush);
+		if(ret == Z_STREAM_ERROR) { return false; }
+		uint32_t n = p->chunk.size() - p->zip.avail_out;
+		if(n > 0 && !png_chunk(p->file, "IDAT", p->chunk.data(), n))
+		{
+			return false;
+		}
+	} while(p->zip.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+	return true;
+}
+
+out::Output::Output(
+	std::string filename, uint32_t width, uint32_t height, uint32_t band)
+{
+	type = BACKEND::PNG;
+	file = filename;
+	w = width;
+	h = height;
+	rows = band == 0 || band > height ? height : band;
+	canvas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, rows);
+	png = new pngstream();
+	png->file = fopen(file.c_str(), "wb");
+	png->ok = png->file != NULL;
+	png->done = 0;
+	png->line.resize((size_t)w * 4 + 1);
+	png->chunk.resize(1 << 16);
+	png->ok = png->ok && deflateInit(&png->zip, Z_DEFAULT_COMPRESSION) == Z_OK;
+	if(!png->ok) { return; }
+	// Signature and header, 8 bit RGBA without interlacing
+	const uint8_t sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	std::vector<uint8_t> ihdr;
+	put32(ihdr, w);
+	put32(ihdr, h);
+	ihdr.insert(ihdr.end(), {8, 6, 0, 0, 0});
+	png->ok = fwrite(sig, 1, 8, png->file) == 8
+		&& png_chunk(png->file, "IHDR", ihdr.data(), ihdr.size());
+}
+
+bool out::Output::stream(uint32_t count)
+{
+	if(png == NULL || !png->ok) { return false; }
+	cairo_surface_flush(canvas);
+	unsigned char* data = cairo_image_surface_get_data(canvas);
+	int stride = cairo_image_surface_get_stride(canvas);
+	for(uint32_t y = 0; y < count && y < rows && png->done < h; y++)
+	{
+		// Each scanline starts with its filter, none
+		png->line[0] = 0;
+		straight((uint32_t*)(data + y * stride), png->line.data() + 1, w);
+		png->zip.next_in = png->line.data();
+		png->zip.avail_in = png->line.size();
+		png->ok = png->ok && png_deflate(png, Z_NO_FLUSH);
+		png->done++;
+	}
+	return png->ok;
+}
+
+out::Output::~Output()
+{
+	cairo_surface_destroy(canvas);
+	if(png == NULL) { return; }
+	if(png->file != NULL) { fclose(png->file); }
+	deflateEnd(&png->zip);
+	delete png;
+}
+
+bool out::Output::finish()
+{
+	switch(type)
+	{
+		case BACKEND::SVG:
+		case BACKEND::PDF:
+			cairo_surface_finish(canvas);
+			break;
+		case BACKEND::PNG:
+			if(png != NULL)
+			{
+				// Close the stream, every row must have been written
+				if(!png->ok || png->done != h) { return false; }
+				png->ok = png_deflate(png, Z_FINISH)
+					&& png_chunk(png->file, "IEND", NULL, 0)
+					&& fclose(png->file) == 0;
+				png->file = NULL;
+				return png->ok;
+			}
+			cairo_surface_flush(canvas);
+			if(cairo_surface_write_to_png(canvas, file.c_str()))
+			{
+				return false;
+			}
+			break;
+		case BACKEND::RGBA:
+			cairo_surface_flush(canvas);
+			break;
+	}
+	return cairo_surface_status(canvas) == CAIRO_STATUS_SUCCESS;
+}
+
+std::vector<uint8_t> out::Output::rgba()
+{
+	std::vector<uint8_t> ret;
+	if(type != BACKEND::PNG && type != BACKEND::RGBA) { return ret; }
+	if(rows != 0) { return ret; }
+	cairo_surface_flush(canvas);
+	unsigned char* data = cairo_image_surface_get_data(canvas);
+	int stride = cairo_image_surface_get_stride(canvas);
+	ret.resize((size_t)w * h * 4);
+	for(uint32_t y = 0; y < h; y++)
+	{
+		uint32_t* row = (uint32_t*)(data + y * stride);
+		straight(row, ret.data() + (size_t)y * w * 4, w);
+	}
+	return ret;
+}
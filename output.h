@@ -0,0 +1,63 @@
+// C imports
+#include <cairo.h>
+
+// C++ imports
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifndef output_h
+#define output_h
+namespace out
+{
+	// The kinds of output a workspace can render to
+	enum BACKEND : uint32_t
+	{
+		SVG,
+		PDF,
+		PNG,
+		RGBA
+	};
+
+	// Parse a backend name (svg, pdf, png, rgba), false if unknown
+	bool backend(std::string, BACKEND&);
+	std::string name(BACKEND);
+
+	// A PNG written a band of rows at a time, see output.c
+	struct pngstream;
+
+	// An output surface of a given resolution that records are played onto
+	class Output
+	{
+		BACKEND type;
+		std::string file;
+		uint32_t w;
+		uint32_t h;
+		cairo_surface_t* canvas;
+		// Banded PNGs keep only a band of rows and stream them to the file
+		uint32_t rows;
+		pngstream* png;
+		public:
+			Output(BACKEND, std::string filename, uint32_t width, uint32_t height);
+			// A PNG drawn band by band, the surface is only band rows high
+			Output(std::string filename, uint32_t width, uint32_t height,
+				uint32_t band);
+			~Output();
+			// Data access
+			BACKEND backend() { return type; }
+			std::string filename() { return file; }
+			uint32_t width() { return w; }
+			uint32_t height() { return h; }
+			cairo_surface_t* surface() { return canvas; }
+			// Rows in a band, zero unless banded
+			uint32_t band() { return rows; }
+			// Write the first count rows of the surface as the next rows of
+			// a banded PNG
+			bool stream(uint32_t count);
+			// Complete the output, writing the file for file backends
+			bool finish();
+			// Straight (not premultiplied) RGBA bytes of raster outputs
+			std::vector<uint8_t> rgba();
+	};
+};
+#endif
@@ -4,9 +4,7 @@
 // C++ imports
 #include <vector>
 #include <string>
-#include <map>
 #include <functional>
-#include <random>
 
 // Module imports
 #include "distribution.h"
@@ -19,63 +17,100 @@ using namespace geom;
 // TODO: REMOVE
 #include <iostream>
 
+// Colours are packed as 0xRRGGBB at compile time
 // Single color palettes
-static std::vector<std::string> white
+static constexpr uint32_t white[] =
 {
-	"F0F9FE", "F8F8FF", "F2F3F4", "FFFFFF"
+	0xF0F9FE, 0xF8F8FF, 0xF2F3F4, 0xFFFFFF
 };
 
-static std::vector<std::string> red
+static constexpr uint32_t red[] =
 {
-	"750400", "950D06", "C60F00", "E50C17", "F1322C"
+	0x750400, 0x950D06, 0xC60F00, 0xE50C17, 0xF1322C
 };
 
-static std::vector<std::string> green
+static constexpr uint32_t green[] =
 {
-	"546811", "697C12", "81971C", "98AA11", "BBCD32", "D2D83F"
+	0x546811, 0x697C12, 0x81971C, 0x98AA11, 0xBBCD32, 0xD2D83F
 };
 
-static std::vector<std::string> blue
+static constexpr uint32_t blue[] =
 {
-	"1E90FF", "187DE9", "126AD2", "0C56BC", "0C56BC", "0643A5", "00308F"
+	0x1E90FF, 0x187DE9, 0x126AD2, 0x0C56BC, 0x0C56BC, 0x0643A5, 0x00308F
 };
 
+// A nice palette of red hues!
+static constexpr uint32_t reds_primary[] =
+{
+	0xC61B00, 0xDE2D0B, 0xEC3511, 0xFA3C16, 0xFF431A
+};
+
+static constexpr uint32_t reds_complimentary[] =
+{
+	0x00A2BD, 0x09B7D8, 0x11C8EC, 0x2BD0F1, 0x52D9F5
+};
+
+static constexpr uint32_t reds_triadic[] =
+{
+	0xACC300, 0xBCD902, 0xC8EC11, 0xD0EF46, 0xD9F36C
+};
+
+// PRIDE, WHOO!!!!
+static constexpr uint32_t trans_primary[] =
+{
+	0xFFFFFF, 0xF88BC2, 0x47A9FA, 0xCA93CA
+};
+
+static constexpr uint32_t trans_complimentary[] =
+{
+	0xF8BCD4, 0x906ACE, 0xFF9DC0, 0x7253B8, 0xFE63AC, 0x4F2685
+};
+
+// Random palettes have this many colours
+static const uint32_t RANDOM_SIZE = 100;
+
+template <uint32_t N> constexpr Swatch swatch(const uint32_t (&table)[N])
+{
+	return {table, N};
+}
+
+int hex_digit(char c)
+{
+	if(c >= '0' && c <= '9') { return c - '0'; }
+	if(c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+	if(c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+	return 0;
+}
 
 Color color_hex(std::string hex)
 {
-	// TODO: SAFETY LMAO
-	std::map<char,int> charMap
+	uint32_t rgb = 0;
+	for(uint32_t i = 0; i < 6; i++)
 	{
-	{'0', 0}, {'1',1}, {'2',2}, {'3',3}, {'4',4},
-	{'5', 5}, {'6',6}, {'7',7}, {'8',8}, {'9',9},
-	{'a', 10}, {'b',11}, {'c',12}, {'d',13}, {'e',14}, {'f',15},
-	{'A', 10}, {'B',11}, {'C',12}, {'D',13}, {'E',14}, {'F',15}
-	};
-	int red = charMap[hex.c_str()[0]] * 16 + charMap[hex.c_str()[1]];
-	int green = charMap[hex.c_str()[2]] * 16 + charMap[hex.c_str()[3]];
-	int blue = charMap[hex.c_str()[4]] * 16 + charMap[hex.c_str()[5]];
+		rgb = rgb * 16 + (i < hex.size() ? hex_digit(hex[i]) : 0);
+	}
+	return color_packed(rgb);
+}
+
+Color color_packed(uint32_t rgb)
+{
 	return
 	{
-		.name = std::string(hex),
-		.red = (red / 255.0),
-		.green = (green / 255.0),
-		.blue = (blue / 255.0)
+		.red = ((rgb >> 16) & 0xFF) / 255.0,
+		.green = ((rgb >> 8) & 0xFF) / 255.0,
+		.blue = (rgb & 0xFF) / 255.0
 	};
 }
 
-Color color_rand(Workspace* ws)
+rec::Source color_source(Color color, double alpha)
 {
-	char chars[16] = {
-		'0','1','2','3','4',
-		'5','6','7','8','9',
-		'A','B','C','D','E','F'};
-	std::string hexcode = "000000";
-	for(int i = 0; i < 6; i++)
+	return
 	{
-		int index = ws->rand() * 16.0;
-		hexcode[i] = chars[index];
-	}
-	return color_hex(hexcode);
+		.red = (float)color.red,
+		.green = (float)color.green,
+		.blue = (float)color.blue,
+		.alpha = (float)alpha
+	};
 }
 
 PaletteFactory::PaletteFactory()
@@ -92,122 +127,61 @@ PaletteFactory::PaletteFactory()
 	};
 }
 
-Palette from_string_vecs(
-	std::vector<std::string> primary,
-	std::vector<std::string> complimentary,
-	std::vector<std::string> triadic)
-{
-	Palette palette;
-	for(auto str : primary)
-	{
-		palette.primary.push_back(color_hex(str));
-	}
-	for(auto str : complimentary)
-	{
-		palette.complimentary.push_back(color_hex(str));
-	}
-	for(auto str : triadic)
-	{
-		palette.triadic.push_back(color_hex(str));
-	}
-	return palette;
-}
-
-// A nice palette of red hues!
 Palette reds()
 {
-	std::vector<std::string> primary
-	{
-		"c61b00", "de2d0b", "ec3511", "fa3c16", "ff431a"
-	};
-	std::vector<std::string> complimentary
-	{
-		"00a2bd", "09b7d8", "11c8ec", "2bd0f1", "52d9f5"
-	};
-	std::vector<std::string> triadic
+	return
 	{
-		"acc300", "bcd902", "c8ec11", "d0ef46", "d9f36c"
+		swatch(reds_primary),
+		swatch(reds_complimentary),
+		swatch(reds_triadic),
+		false,
+		0
 	};
-	return from_string_vecs(primary, complimentary, triadic);
 }
 
-// PRIDE, WHOO!!!!
 Palette trans()
 {
-	std::vector<std::string> primary
-	{
-		"ffffff", "f88bc2", "47a9fa", "ca93ca",
-	};
-	std::vector<std::string> complimentary
+	return
 	{
-		"F8BCD4", "906ACE", "ff9DC0", "7253B8", "FE63AC", "4F2685"
+		swatch(trans_primary),
+		swatch(trans_complimentary),
+		swatch(white),
+		false,
+		0
 	};
-	std::vector<std::string> triadic = white;
-
-	return from_string_vecs(primary, complimentary, triadic);
 }
 
-// A palette of many random colors!
+// A palette of many random colors, made lazily from one draw
 Palette random_palette(Workspace* ws)
 {
-	Palette palette;
-	for(int i = 0; i < 100; i++)
-	{
-		palette.primary.push_back(color_rand(ws));
-	}
-	return palette;
-}
-
-Palette greens()
-{
-	return from_string_vecs(green,{},{});
-}
-
-Palette blues()
-{
-	return from_string_vecs(blue,{},{});
+	uint64_t seed = ws->rand() * 0x1.0p53;
+	return {{NULL, RANDOM_SIZE}, {NULL, 0}, {NULL, 0}, true, seed};
 }
 
+Palette greens() { return {swatch(green), {NULL, 0}, {NULL, 0}, false, 0}; }
+Palette blues() { return {swatch(blue), {NULL, 0}, {NULL, 0}, false, 0}; }
 
 Palette pick_palette(Workspace* ws, uint32_t mask)
 {
-	if(mask == 0) { return random_palette(ws); }
-	// Merge palettes according to rules
-	std::vector<Palette> base;
+	// TODO: MERGE BASE PALETTES IN A CLEVER WAY! For now the lowest bit wins
 	for(auto x : BitIterator<enum palette>())
 	{
 		switch(mask & (uint32_t)x)
 		{
-			case (uint32_t)palette::RAND:
-				base.push_back(random_palette(ws));
-				break;
-			case (uint32_t)palette::REDS:
-				base.push_back(reds());
-				break;
-			case (uint32_t)palette::TRANS:
-				base.push_back(trans());
-				break;
-			case (uint32_t)palette::BLUES:
-				base.push_back(blues());
-				break;
-			case (uint32_t)palette::GREENS:
-				base.push_back(greens());
-				break;
+			case (uint32_t)palette::RAND: return random_palette(ws);
+			case (uint32_t)palette::REDS: return reds();
+			case (uint32_t)palette::TRANS: return trans();
+			case (uint32_t)palette::BLUES: return blues();
+			case (uint32_t)palette::GREENS: return greens();
 		}
 	}
-
-	// TODO: MERGE BASE PALETTES IN A CLEVER WAY!
-	return base[0];
+	return random_palette(ws);
 }
 
-Color pick_color(
-	Workspace* ws,
-	Palette* p,
-	std::vector<Constraint> constraints)
+Color pick_color(Workspace* ws, Palette* p)
 {
-	// TODO: Make it a bit smarter yo
-	// auto match = match_constraint("palette", constraints);
-	// auto prtrb = match_constraint("perturb", constraints);
+	// TODO: Make it a bit smarter yo, with the palette and perturbation
+	// constraints of the segment
 
 	// TODO: debug this!
 	double dial_d = -1.0;
@@ -217,13 +191,18 @@ Color pick_color(
 	
 	float del = dial_d;
 	float del_inv = 1.0 - del;
-	int place = (del_inv * dial_p + del * ws->rand()) * p->primary.size();
+	int place = (del_inv * dial_p + del * ws->rand()) * p->primary.size;
 
 	// Small perturbation!
-	if((uint32_t)place > p->primary.size() || place < 0)
+	if((uint32_t)place >= p->primary.size || place < 0)
+	{
+		return {0.0, 0.0, 0.0};
+	}
+	// A random colour is the same for the same seed and place
+	if(p->random)
 	{
-		return {"black", 0.0, 0.0, 0.0};
+		rng::Random stream = rng::Random(p->seed).split(place);
+		return color_packed(stream.next() >> 40);
 	}
-	Color color = p->primary[place];
-	return color;
+	return color_packed(p->primary.color[place]);
 }
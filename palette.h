@@ -19,21 +19,34 @@ enum class palette : uint32_t
 
 typedef struct color
 {
-	std::string name;
 	double red;
 	double green;
 	double blue; 
 } Color;
 
+// A run of colours packed as 0xRRGGBB in a table built at compile time
+typedef struct swatch
+{
+	const uint32_t* color;
+	uint32_t size;
+} Swatch;
+
+// Palettes only point into the tables, so picking one allocates nothing.
+// Random palettes have no table, each colour is made when it is picked
+// from a stream keyed by the palette seed and the colour's place.
 typedef struct pallete_t
 {
-	std::vector<Color> primary;
-	std::vector<Color> complimentary;
-	std::vector<Color> triadic;
+	Swatch primary;
+	Swatch complimentary;
+	Swatch triadic;
+	bool random;
+	uint64_t seed;
 } Palette;
 
 
 Color color_hex(std::string hex);
+Color color_packed(uint32_t rgb);
+rec::Source color_source(Color, double alpha);
 
 class PaletteFactory : public ConstraintFactory
 {
@@ -42,5 +55,5 @@ class PaletteFactory : public ConstraintFactory
 };
 
 Palette pick_palette(Workspace*, uint32_t);
-Color pick_color(Workspace*, Palette*, std::vector<Constraint>);
+Color pick_color(Workspace*, Palette*);
 #endif
@@ -0,0 +1,80 @@
+// C++ imports
+#include <thread>
+#include <atomic>
+#include <vector>
+
+// Module imports
+#include "parallel.h"
+
+uint32_t par::concurrency()
+{
+	uint32_t hw = std::thread::hardware_concurrency();
+	return hw == 0 ? 1 : hw;
+}
+
+void par::parallel_for(
+	uint32_t N,
+	uint32_t workers,
+	std::function<void(uint32_t)> job)
+{
+	// No need for threads if there is nothing to share
+	workers = workers > N ? N : workers;
+	if(workers <= 1)
+	{
+		for(uint32_t i = 0; i < N; i++) { job(i); }
+		return;
+	}
+	// Each worker pulls the next job until they are all taken
+	std::atomic<uint32_t> next {0};
+	auto worker = [&]() -> void
+	{
+		for(uint32_t i = next++; i < N; i = next++) { job(i); }
+	};
+	std::vector<std::thread> pool;
+	for(uint32_t w = 1; w < workers; w++) { pool.emplace_back(worker); }
+	worker();
+	for(auto &t : pool) { t.join(); }
+}
+
+par::Worker::Worker(size_t cap)
+{
+	capacity = cap == 0 ? 1 : cap;
+	done = false;
+	thread = std::thread(&Worker::run, this);
+}
+
+par::Worker::~Worker()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done = true;
+	}
+	changed.notify_all();
+	thread.join();
+}
+
+void par::Worker::push(std::function<void()> job)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [&]() { return queue.size() < capacity; });
+	queue.push_back(job);
+	guard.unlock();
+	changed.notify_all();
+}
+
+void par::Worker::run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while(true)
+	{
+		changed.wait(guard, [&]() { return done || !queue.empty(); });
+		if(queue.empty()) { return; }
+		std::function<void()> job = queue.front();
+		queue.pop_front();
+		// Let the producer refill while the job runs
+		guard.unlock();
+		changed.notify_all();
+		job();
+		guard.lock();
+	}
+}
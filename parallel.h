@@ -0,0 +1,42 @@
+#include <functional>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef parallel_h
+#define parallel_h
+namespace par
+{
+	// The number of workers to use when none is requested
+	uint32_t concurrency();
+	// Run job(i) for every i in [0,N) on up to a number of worker threads.
+	// Jobs are handed out in index order from a shared counter and the call
+	// returns once all of them are done. One worker runs inline.
+	void parallel_for(
+		uint32_t N,
+		uint32_t workers,
+		std::function<void(uint32_t)> job);
+
+	// A background thread running jobs in the order they are pushed. The
+	// queue is bounded, so a fast producer waits instead of piling up work.
+	// Destruction runs the remaining jobs and joins the thread.
+	class Worker
+	{
+		std::deque<std::function<void()>> queue;
+		size_t capacity;
+		bool done;
+		std::mutex lock;
+		std::condition_variable changed;
+		std::thread thread;
+		void run();
+		public:
+			Worker(size_t capacity);
+			~Worker();
+			Worker(const Worker&) = delete;
+			Worker& operator=(const Worker&) = delete;
+			void push(std::function<void()> job);
+	};
+};
+#endif
@@ -0,0 +1,80 @@
+// C++ imports
+#include <cstdint>
+
+#ifndef random_h
+#define random_h
+namespace rng
+{
+	class Random;
+	// The stream of the task running on this thread, if any. While it is
+	// set, every Random on the thread draws from it instead.
+	inline thread_local Random* task = NULL;
+
+	// Mix a 64 bit word into a well distributed one (splitmix64)
+	inline uint64_t mix(uint64_t z)
+	{
+		z += 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	// A small, fast generator (xoshiro256**) that splits into independent
+	// deterministic sub-streams keyed by segment or task.
+	class Random
+	{
+		uint64_t s[4];
+		static uint64_t rotl(uint64_t x, int k)
+		{
+			return (x << k) | (x >> (64 - k));
+		}
+		public:
+			Random(uint64_t seed = 0)
+			{
+				for(int i = 0; i < 4; i++) { s[i] = mix(seed + i); }
+			}
+			// The next raw 64 bits of this stream
+			uint64_t next()
+			{
+				uint64_t ret = rotl(s[1] * 5, 7) * 9;
+				uint64_t t = s[1] << 17;
+				s[2] ^= s[0];
+				s[3] ^= s[1];
+				s[1] ^= s[2];
+				s[0] ^= s[3];
+				s[2] ^= t;
+				s[3] = rotl(s[3], 45);
+				return ret;
+			}
+			// A uniform double in [0,1) from this stream
+			double uniform() { return (next() >> 11) * 0x1.0p-53; }
+			// A uniform double in [0,1) from the task stream, if one is set
+			double operator()()
+			{
+				return task == NULL ? uniform() : task->uniform();
+			}
+			// A sub-stream keyed from the current state, without drawing
+			Random split(uint64_t key) const
+			{
+				uint64_t h = mix(key);
+				for(int i = 0; i < 4; i++) { h = mix(h ^ s[i]); }
+				return Random(h);
+			}
+			// Raw state, for saving and restoring a stream exactly
+			const uint64_t* state() const { return s; }
+			void restore(const uint64_t* state)
+			{
+				for(int i = 0; i < 4; i++) { s[i] = state[i]; }
+			}
+	};
+
+	// Set the task stream of this thread for as long as the scope lives
+	class Scope
+	{
+		Random* prev;
+		public:
+			Scope(Random* stream) : prev{task} { task = stream; }
+			~Scope() { task = prev; }
+	};
+};
+#endif
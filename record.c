@@ -0,0 +1,336 @@
+// C imports
+#include <math.h>
+#include <cairo.h>
+
+// C++ imports
+#include <vector>
+#include <algorithm>
+
+// Module imports
+#include "geom.h"
+#include "record.h"
+
+// Boxes that are empty never overlap anything
+static const rec::Box empty = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+
+static rec::Box merge(rec::Box a, rec::Box b)
+{
+	return
+	{
+		a.x0 < b.x0 ? a.x0 : b.x0,
+		a.y0 < b.y0 ? a.y0 : b.y0,
+		a.x1 > b.x1 ? a.x1 : b.x1,
+		a.y1 > b.y1 ? a.y1 : b.y1
+	};
+}
+
+bool rec::overlap(Box a, Box b)
+{
+	if(a.x0 > a.x1 || b.x0 > b.x1) { return false; }
+	return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+// Opaque fills and strokes with the same paint can share a single path
+static bool same_paint(const rec::Command& a, const rec::Command& b)
+{
+	bool draw = a.op == rec::OP::FILL || a.op == rec::OP::STROKE;
+	return draw && a.op == b.op
+		&& a.source.red == b.source.red
+		&& a.source.green == b.source.green
+		&& a.source.blue == b.source.blue
+		&& a.source.alpha == 1.0 && b.source.alpha == 1.0
+		&& a.width == b.width;
+}
+
+static bool is_identity(const Vertex* m)
+{
+	return m[0].x == 1.0 && m[0].y == 0.0 && m[1].x == 0.0 && m[1].y == 1.0
+		&& m[2].x == 0.0 && m[2].y == 0.0;
+}
+
+uint32_t rec::Buffer::pool(std::vector<Vertex> vrt)
+{
+	uint32_t first = point.size();
+	point.insert(point.end(), vrt.begin(), vrt.end());
+	return first;
+}
+
+void rec::Buffer::fill(Polygon poly, Source src)
+{
+	if(poly.size() == 0) { return; }
+	// Keep every fill counterclockwise, so fills merged into one path
+	// never cancel each other out where they overlap
+	if(geom::signed_area(poly) < 0.0) { std::reverse(poly.begin(), poly.end()); }
+	uint32_t first = pool(poly);
+	command.push_back({OP::FILL, src, 0.0, first, (uint32_t)poly.size()});
+}
+
+void rec::Buffer::stroke(Polygon line, double width, Source src)
+{
+	if(line.size() == 0) { return; }
+	uint32_t first = pool(line);
+	command.push_back(
+		{OP::STROKE, src, (float)width, first, (uint32_t)line.size()});
+}
+
+void rec::Buffer::arc(
+	Vertex center, double radius, double a1, double a2, Source src)
+{
+	// Center, then the radius and the two angles
+	uint32_t first = pool({center, {radius, 0.0}, {a1, a2}});
+	command.push_back({OP::ARC, src, 0.0, first, 3});
+}
+
+void rec::Buffer::transform(Vertex origin, double angle, double sx, double sy)
+{
+	// Same as a translate, rotate then scale in cairo: columns of the
+	// affine matrix followed by the translation
+	double c = cos(angle);
+	double s = sin(angle);
+	uint32_t first = pool({{c * sx, s * sx}, {-s * sy, c * sy}, origin});
+	command.push_back({OP::TRANSFORM, {0.0, 0.0, 0.0, 0.0}, 0.0, first, 3});
+}
+
+void rec::Buffer::identity() { transform({0.0, 0.0}, 0.0, 1.0, 1.0); }
+
+void rec::Buffer::copy(const Buffer& from, uint32_t id)
+{
+	Command c = from.command[id];
+	auto start = from.point.begin() + c.first;
+	c.first = point.size();
+	point.insert(point.end(), start, start + c.count);
+	command.push_back(c);
+}
+
+void rec::Buffer::append(const Buffer& from)
+{
+	for(uint32_t i = 0; i < from.size(); i++) { copy(from, i); }
+}
+
+std::vector<rec::Box> rec::Buffer::bounds() const
+{
+	std::vector<Box> ret;
+	// The current transform, as in the TRANSFORM command layout
+	Vertex m[3] = {{1.0, 0.0}, {0.0, 1.0}, {0.0, 0.0}};
+	auto apply = [&](Vertex v) -> Vertex
+	{
+		return
+		{
+			m[0].x * v.x + m[1].x * v.y + m[2].x,
+			m[0].y * v.x + m[1].y * v.y + m[2].y
+		};
+	};
+	for(auto c : command)
+	{
+		const Vertex* p = &point[c.first];
+		// Largest stretch of the transform, for widths and radii
+		double stretch = std::max(
+			geom::magnitude(m[0]),
+			geom::magnitude(m[1]));
+		// One pixel of slack for antialiasing
+		double pad = 1.0;
+		Box box = empty;
+		switch(c.op)
+		{
+			case OP::TRANSFORM:
+				m[0] = p[0]; m[1] = p[1]; m[2] = p[2];
+				ret.push_back(empty);
+				continue;
+			case OP::ARC:
+			{
+				Vertex o = apply(p[0]);
+				double r = p[1].x * stretch;
+				box = {o.x - r, o.y - r, o.x + r, o.y + r};
+				break;
+			}
+			case OP::STROKE:
+				pad += c.width * stretch / 2.0;
+				[[fallthrough]];
+			case OP::FILL:
+				for(uint32_t i = 0; i < c.count; i++)
+				{
+					Vertex v = apply(p[i]);
+					box = merge(box, {v.x, v.y, v.x, v.y});
+				}
+				break;
+		}
+		ret.push_back({box.x0 - pad, box.y0 - pad, box.x1 + pad, box.y1 + pad});
+	}
+	return ret;
+}
+
+rec::Buffer rec::Buffer::batched(uint32_t lookback) const
+{
+	std::vector<Box> box = bounds();
+	// A unit is a single command at the identity transform, or a whole
+	// transformed block up to the transform back to identity. Only single
+	// fills and strokes are ever moved.
+	struct unit { uint32_t first; uint32_t last; bool movable; Box box; };
+	std::vector<unit> units;
+	bool ident = true;
+	for(uint32_t i = 0; i < command.size(); i++)
+	{
+		const Command& c = command[i];
+		bool draw = c.op == OP::FILL || c.op == OP::STROKE;
+		if(ident) { units.push_back({i, i, ident && draw, box[i]}); }
+		else
+		{
+			units.back().last = i;
+			units.back().box = merge(units.back().box, box[i]);
+		}
+		if(c.op == OP::TRANSFORM) { ident = is_identity(&point[c.first]); }
+	}
+	// Runs of units drawn one after another. A movable unit joins the
+	// latest run with the same paint, unless a run it overlaps is in the way.
+	struct run { std::vector<uint32_t> unit; bool movable; Box box; };
+	std::vector<run> runs;
+	for(uint32_t u = 0; u < units.size(); u++)
+	{
+		int32_t join = -1;
+		const Command& c = command[units[u].first];
+		int32_t stop = runs.size() > lookback ? runs.size() - lookback : 0;
+		for(int32_t r = runs.size() - 1; units[u].movable && r >= stop; r--)
+		{
+			const Command& k = command[units[runs[r].unit[0]].first];
+			if(runs[r].movable && same_paint(k, c)) { join = r; break; }
+			if(overlap(runs[r].box, units[u].box)) { break; }
+		}
+		if(join == -1)
+		{
+			runs.push_back({{u}, units[u].movable, units[u].box});
+			continue;
+		}
+		runs[join].unit.push_back(u);
+		runs[join].box = merge(runs[join].box, units[u].box);
+	}
+	// Lay the runs out in order
+	Buffer ret;
+	for(auto &r : runs)
+	{
+		for(auto u : r.unit)
+		{
+			for(uint32_t i = units[u].first; i <= units[u].last; i++)
+			{
+				ret.copy(*this, i);
+			}
+		}
+	}
+	return ret;
+}
+
+void rec::Buffer::clear()
+{
+	command.clear();
+	point.clear();
+}
+
+uint32_t rec::play(
+	const Buffer& buffer, cairo_surface_t* surface, bool batch, double zoom)
+{
+	std::vector<uint32_t> all(buffer.size());
+	for(uint32_t i = 0; i < all.size(); i++) { all[i] = i; }
+	return play(buffer, all, surface, batch, zoom, {0.0, 0.0});
+}
+
+std::vector<uint32_t> rec::touching(
+	const Buffer& buffer, const std::vector<Box>& bounds, Box window)
+{
+	std::vector<uint32_t> ret;
+	const std::vector<Command>& command = buffer.commands();
+	for(uint32_t i = 0; i < command.size(); i++)
+	{
+		if(command[i].op == OP::TRANSFORM || overlap(bounds[i], window))
+		{
+			ret.push_back(i);
+		}
+	}
+	return ret;
+}
+
+uint32_t rec::play(
+	const Buffer& buffer,
+	const std::vector<uint32_t>& pick,
+	cairo_surface_t* surface,
+	bool batch,
+	double zoom,
+	Vertex origin)
+{
+	cairo_t* drawer = cairo_create(surface);
+	// The surface shows the canvas from origin on
+	auto place = [&]() -> void
+	{
+		cairo_identity_matrix(drawer);
+		cairo_translate(drawer, -origin.x, -origin.y);
+		cairo_scale(drawer, zoom, zoom);
+	};
+	place();
+	const std::vector<Vertex>& point = buffer.points();
+	const std::vector<Command>& command = buffer.commands();
+	// Whether a picked command continues the path of the one before it
+	auto merges = [&](uint32_t k) -> bool
+	{
+		if(!batch || k == 0 || k >= pick.size()) { return false; }
+		return same_paint(command[pick[k - 1]], command[pick[k]]);
+	};
+	uint32_t paths = 0;
+	for(uint32_t k = 0; k < pick.size(); k++)
+	{
+		const Command& c = command[pick[k]];
+		const Vertex* p = &point[c.first];
+		Source s = c.source;
+		bool open = merges(k);
+		bool more = merges(k + 1);
+		switch(c.op)
+		{
+			case OP::FILL:
+				if(!open)
+				{
+					cairo_set_source_rgba(
+						drawer, s.red, s.green, s.blue, s.alpha);
+				}
+				cairo_move_to(drawer, p[0].x, p[0].y);
+				for(uint32_t v = 1; v < c.count; v++)
+				{
+					cairo_line_to(drawer, p[v].x, p[v].y);
+				}
+				cairo_close_path(drawer);
+				if(!more) { cairo_fill(drawer); paths++; }
+				break;
+			case OP::STROKE:
+				if(!open)
+				{
+					cairo_set_line_width(drawer, c.width);
+					cairo_set_source_rgba(
+						drawer, s.red, s.green, s.blue, s.alpha);
+				}
+				cairo_move_to(drawer, p[0].x, p[0].y);
+				for(uint32_t v = 1; v < c.count; v++)
+				{
+					cairo_line_to(drawer, p[v].x, p[v].y);
+				}
+				if(!more) { cairo_stroke(drawer); paths++; }
+				break;
+			case OP::ARC:
+				cairo_set_source_rgba(drawer, s.red, s.green, s.blue, s.alpha);
+				cairo_new_path(drawer);
+				cairo_arc(drawer, p[0].x, p[0].y, p[1].x, p[2].x, p[2].y);
+				cairo_fill(drawer);
+				paths++;
+				break;
+			case OP::TRANSFORM:
+			{
+				cairo_matrix_t m =
+				{
+					p[0].x, p[0].y,
+					p[1].x, p[1].y,
+					p[2].x, p[2].y
+				};
+				place();
+				cairo_transform(drawer, &m);
+				break;
+			}
+		}
+	}
+	cairo_destroy(drawer);
+	return paths;
+}
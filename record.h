@@ -0,0 +1,108 @@
+// C imports
+#include <cairo.h>
+
+// C++ imports
+#include <vector>
+#include <cstdint>
+
+// Module imports
+#include "geom.h"
+
+#ifndef record_h
+#define record_h
+using geom::Vertex;
+using geom::Polygon;
+
+namespace rec
+{
+	// The kinds of draw commands a brush can emit
+	enum OP : uint8_t
+	{
+		FILL,
+		STROKE,
+		ARC,
+		TRANSFORM
+	};
+
+	// The paint used by a command
+	typedef struct source
+	{
+		float red;
+		float green;
+		float blue;
+		float alpha;
+	} Source;
+
+	// An axis aligned bounding box in pixels
+	typedef struct box
+	{
+		double x0;
+		double y0;
+		double x1;
+		double y1;
+	} Box;
+
+	bool overlap(Box, Box);
+
+	// A single draw command. Its geometry lives in the buffer point pool
+	// starting at first. Transforms store their matrix as three points.
+	typedef struct command
+	{
+		OP op;
+		Source source;
+		float width;
+		uint32_t first;
+		uint32_t count;
+	} Command;
+
+	// A buffer of draw commands in pixel coordinates, in drawing order
+	class Buffer
+	{
+		std::vector<Command> command;
+		std::vector<Vertex> point;
+		uint32_t pool(std::vector<Vertex>);
+		void copy(const Buffer&, uint32_t);
+		public:
+			// Fill a closed polygon
+			void fill(Polygon, Source);
+			// Stroke an open polyline
+			void stroke(Polygon, double width, Source);
+			// Fill the area swept by an arc around a center
+			void arc(Vertex, double radius, double a1, double a2, Source);
+			// Translate, rotate and scale all following commands
+			void transform(Vertex, double angle, double sx, double sy);
+			void identity();
+			// Reorder commands so that runs sharing the same paint grow,
+			// moving a command at most lookback runs and never past one
+			// it overlaps. Drawing the result gives the same picture.
+			Buffer batched(uint32_t lookback) const;
+			// The bounds of every command, empty for transforms
+			std::vector<Box> bounds() const;
+			// Add the commands of another buffer after these
+			void append(const Buffer&);
+			// Data access
+			void clear();
+			size_t size() const { return command.size(); }
+			const std::vector<Command>& commands() const { return command; }
+			const std::vector<Vertex>& points() const { return point; }
+	};
+
+	// Play a buffer back onto a cairo surface, zoomed by a factor. Batching
+	// draws each run of opaque commands sharing a paint as one path.
+	// Returns the number of paths drawn.
+	uint32_t play(const Buffer&, cairo_surface_t*, bool batch, double zoom);
+	// The commands that can touch a window given the buffer bounds, with
+	// every transform kept so the ones picked draw in the right place
+	std::vector<uint32_t> touching(
+		const Buffer&, const std::vector<Box>& bounds, Box window);
+	// Play only the picked commands, in order, onto a surface showing the
+	// zoomed canvas from an origin in canvas pixels
+	uint32_t play(
+		const Buffer&,
+		const std::vector<uint32_t>& pick,
+		cairo_surface_t*,
+		bool batch,
+		double zoom,
+		Vertex origin);
+};
+#endif
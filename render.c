@@ -1,8 +1,9 @@
 // C imports
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
-#include <cairo-svg.h>
+#include <sys/stat.h>
 #include <cassert>
 
 // C++ imports
@@ -10,7 +11,6 @@
 #include <deque>
 #include <functional>
 #include <algorithm>
-#include <random>
 #include <chrono>
 
 // module imports
@@ -20,12 +20,15 @@
 #include "brushes.h"
 #include "operators.h"
 #include "constraints.h"
+#include "parallel.h"
+#include "sampler.h"
 
 // debug imports
 #include <iostream>
 
 // TODO: need a header file for these companion definitions
-Callback weighted_choice(Workspace* ws, std::vector<Callback> cbs, double d);
+int64_t weighted_choice(Workspace* ws, const std::vector<Score>& cand, double d);
+smp::Weighted score_sampler(const std::vector<Score>& cand);
 
 // We weight operators and brushes by Zip's law to make distinct pictures with
 // the same operators. Think different "languages" based on the same phonemes
@@ -48,6 +51,39 @@ void insertsort(std::vector<Callback> &cb, Callback b)
 	cb.insert(cb.begin() + i, b);
 }
 
+// Constraints in checkpoints refer to their name in the string table
+void save_constraints(
+	ckpt::Writer& w, ckpt::Strings& names, const std::vector<Constraint>& cons)
+{
+	w.varint(cons.size());
+	for(auto& c : cons)
+	{
+		w.varint(names.intern(cst::name(c.key)));
+		w.varint(c.type);
+		w.varint(c.mask);
+		w.real(c.dial);
+	}
+}
+
+bool load_constraints(
+	ckpt::Reader& r,
+	const std::vector<std::string>& names,
+	std::vector<Constraint>& cons)
+{
+	uint64_t size = r.varint();
+	for(uint64_t i = 0; r.good() && i < size; i++)
+	{
+		uint64_t name = r.varint();
+		if(name >= names.size()) { return false; }
+		Constraint c = {cst::key(names[name]), 0, 0, 0.0};
+		c.type = r.varint();
+		c.mask = r.varint();
+		c.dial = r.real();
+		cons.push_back(c);
+	}
+	return r.good();
+}
+
 // Layer class definitions
 Layer::Layer(std::vector<Vertex> start)
 {
@@ -58,21 +94,29 @@ Layer::Layer(std::vector<Vertex> start)
 		vertex.push_back(start[v]);
 		vid.push_back(v);
 	}
-	segment root = {0, vid};
-	shard.push_back(root);
+	segment root = {0, vid, serial++};
+	shard.edit().push_back(root);
 }
 
 Segment Layer::cache(Workspace* ws, uint32_t gid, uint32_t id, uint32_t height)
 {
-	// Cache the global id and reverse
-	segMap[id] = gid;
-	segRev[gid] = id;
+	// Cache the global id and reverse, only writing (and copying) on change
+	auto map = segMap->find(id);
+	if(map == segMap->end() || map->second != gid) { segMap.edit()[id] = gid; }
+	auto rev = segRev->find(gid);
+	if(rev == segRev->end() || rev->second != id) { segRev.edit()[gid] = id; }
 	// Create a new Segment from local knowledge
-	segment sh = shard[id];
+	const segment& sh = (*shard)[id];
 	std::vector<Vertex> bound;
 	for(auto v : sh.vid) { bound.push_back(vertex[v]); }
-	std::vector<Constraint> con = constraint[id];
-	Segment ret = {gid, ws->canvas(), ws->scale(), height, bound, con};
+	// Shards that set nothing themselves share one empty table
+	static const cow::Cow<cst::Table> none;
+	auto found = constraint->find(id);
+	const cow::Cow<cst::Table>& own =
+		found != constraint->end() ? found->second : none;
+	Segment ret =
+		{gid, uid(height, sh.uid), ws->record(), ws->scale(), height, bound,
+		own, defaults};
 	return ret;
 }
 
@@ -80,7 +124,7 @@ std::vector<Segment> Layer::recache(
 	Workspace* ws, uint32_t height, std::function<uint32_t()> gidgenerator)
 {
 	std::vector<Segment> ret;
-	for(auto sh : shard)
+	for(auto& sh : *shard)
 	{
 		uint32_t gid = gidgenerator();
 		ret.push_back(cache(ws, gid, sh.sid, height));
@@ -88,44 +132,61 @@ std::vector<Segment> Layer::recache(
 	return ret;
 }
 
-std::set<uint32_t> Layer::geom(Segment s) { return geomRel[segRev[s.sid]]; }
-std::set<uint32_t> Layer::logic(uint32_t lid)
+graph::Range Layer::neighbours(uint32_t local, uint32_t base)
+{
+	// Reads only, this is called concurrently during render
+	return graph::neighbours(*adjacency, local, base);
+}
+const std::map<uint32_t,std::set<uint32_t>>& Layer::logic()
 {
-	if(!logicRel.count(lid)) { return {}; }
-	return logicRel[lid];
+	return *logicRel;
 }
 
-void Layer::linkLogical(Segment s, uint32_t lid)
+// The local id mapped from a segment id, as an unmapped id maps to zero
+uint32_t Layer::local(uint32_t sid)
 {
-	uint32_t sid = segMap[s.sid];
-	if(!logicRel.count(lid)) { logicRel[lid] = {}; }
-	logicRel[lid].insert(sid);
+	auto found = segRev->find(sid);
+	if(found != segRev->end()) { return found->second; }
+	segRev.edit()[sid] = 0;
+	return 0;
+}
+
+void Layer::linkLogical(uint32_t local, uint32_t lid)
+{
+	logicRel.edit()[lid].insert(local);
 }
 
 uint32_t Layer::ensureVid(Vertex vrt)
 {
-	auto found = geom::find(vertex,vrt);
-	if(found.is) { return found.dat; }
+	for(uint32_t i = 0; i < vertex.size(); i++)
+	{
+		if(eq(vertex[i], vrt)) { return i; }
+	}
 	vertex.push_back(vrt);
-	return ensureVid(vrt);
+	return vertex.size() - 1;
 }
 
-uint32_t Layer::addsegment(std::vector<segment> &base, Polygon poly)
+uint32_t Layer::addsegment(
+	std::vector<segment> &base, Polygon poly, uint64_t uid)
 {
 	uint32_t newsid = base.size();
 	std::vector<uint32_t> id;
 	for(auto vrt : poly) { id.push_back(ensureVid(vrt)); }
-	base.push_back({newsid,id});
+	base.push_back({newsid,id,uid});
 	return newsid;
 }
 
-void Layer::tempere(std::vector<Vertex> boundary)
+void Layer::tempere(std::vector<Vertex> boundary, std::vector<Change>& change)
 {
 	// Updated segments and constraints
 	std::vector<segment> shatter;
-	std::map<uint32_t,std::vector<Constraint>> shattercon;
+	std::map<uint32_t,cow::Cow<cst::Table>> shattercon;
+	// The shard each new one came from, and whether that shard was split
+	std::vector<uint32_t> parent;
+	std::vector<bool> split;
+	std::vector<std::vector<uint32_t>> children(shard->size());
 	// Check for coverage and intersections
-	for(auto p : shard)
+	for(auto& p : *shard)
 	{
 		// Shatter the shard if needed
 		std::vector<Vertex> perimiter;
@@ -133,55 +194,81 @@ void Layer::tempere(std::vector<Vertex> boundary)
 		// Run tempere on the shard
 		auto piece = geom::tempere(perimiter, boundary);
 		// Store the pieces produced in new shards
+		auto con = constraint->find(p.sid);
+		// A shard left whole keeps its uid
+		bool whole = piece.size() == 1;
+		if(!whole) { change.push_back({Change::REMOVED, p.uid}); }
 		for(auto poly : piece)
 		{
-			uint32_t newid = addsegment(shatter, poly);
-			shattercon[newid] = constraint[p.sid];
+			uint64_t uid = whole ? p.uid : serial++;
+			if(!whole) { change.push_back({Change::ADDED, uid}); }
+			uint32_t newid = addsegment(shatter, poly, uid);
+			if(con != constraint->end()) { shattercon[newid] = con->second; }
+			parent.push_back(p.sid);
+			split.push_back(piece.size() > 1);
+			children[p.sid].push_back(newid);
 		}
 	}
 	// For now just straight replace all shards with the new stuff
-	assert(shard.size() <= shatter.size());
+	assert(shard->size() <= shatter.size());
 	// printf("\rShattered %d into %d\n",shard.size(),shatter.size());
 	// fflush(stdout);
 	// DEBUG!
-	if(shard.size() == shatter.size())
+	if(shard->size() == shatter.size())
 	{
-		for(auto p : shard)
+		for(auto& p : *shard)
 		{
 			std::vector<Vertex> perimiter;
 			for(auto v : p.vid) { perimiter.push_back(vertex[v]); }
 			auto piece = geom::tempereDebug(perimiter, boundary);
 		}
 	}
-	shard = shatter;
-	constraint = shattercon;
-	// Store a map of shards and their verticies for local relationships
-	std::map<uint32_t,std::vector<uint32_t>> localMap;
-	for(auto p : shard)
+	// Patch the adjacency. Whole shards keep their links to whole shards,
+	// split pieces can only touch their siblings or the pieces of a shard
+	// their parent touched, so only those are tested.
+	auto poly = [&](uint32_t id) -> Polygon
 	{
-		for(auto id : p.vid)
+		Polygon ret;
+		for(auto v : shatter[id].vid) { ret.push_back(vertex[v]); }
+		return ret;
+	};
+	std::vector<graph::Link> links;
+	for(uint32_t u = 0; u < shatter.size(); u++)
+	{
+		std::vector<uint32_t> near = children[parent[u]];
+		for(auto q : graph::neighbours(*adjacency, parent[u]))
 		{
-			if(!localMap.count(id)) { localMap[id] = {}; }
-			localMap[id].push_back(p.sid);
+			near.insert(near.end(), children[q].begin(), children[q].end());
+		}
+		Polygon pu = split[u] ? poly(u) : Polygon();
+		for(auto v : near)
+		{
+			if(v == u) { continue; }
+			if(!split[u] && !split[v]) { links.push_back({u,v}); }
+			// Pairs with a split piece are tested once, from a split side
+			else if(split[u] && (!split[v] || v > u))
+			{
+				if(geom::share_edge(pu, poly(v))) { links.push_back({u,v}); }
+			}
 		}
 	}
-	// Clear the local relationships
-	geomRel = {};
-	// Create the local relationships anew
-	for(auto p : shard)
+	adjacency = graph::build(shatter.size(), links);
+	// Pieces keep the logical links of the shard they came from
+	if(logicRel->size() > 0)
 	{
-		for(auto id : p.vid)
+		std::map<uint32_t,std::set<uint32_t>> shatterlogic;
+		for(auto & [lid,members] : *logicRel)
 		{
-			for(auto sid : localMap[id])
+			for(auto m : members)
 			{
-				if(!geomRel.count(p.sid))
-				{
-					geomRel[p.sid] = {};
-				}
-				geomRel[p.sid].insert(sid);
+				if(m >= children.size()) { continue; }
+				shatterlogic[lid].insert(children[m].begin(), children[m].end());
 			}
 		}
+		logicRel = shatterlogic;
 	}
+	shard = shatter;
+	constraint = shattercon;
 }
 
 std::vector<Segment> Layer::unmappedSegment(
@@ -190,9 +277,9 @@ std::vector<Segment> Layer::unmappedSegment(
 	// std::cout << "TOTAL SHARDS " << shard.size() << std::endl;
 	// Make sure all segments are mapped, make a list of unmapped segments
 	std::vector<segment> remap;
-	for(auto s : shard)
+	for(auto& s : *shard)
 	{
-		if(segRev.count(s.sid) == 0) { remap.push_back(s); }
+		if(segRev->count(s.sid) == 0) { remap.push_back(s); }
 	}
 	// std::cout << "UNMAPPED SHARDS " << remap.size() << std::endl;
 	std::vector<Segment> ret;
@@ -206,28 +293,109 @@ std::vector<Segment> Layer::unmappedSegment(
 
 void Layer::updateConstraint(Segment seg, std::vector<Constraint> con)
 {
-	uint32_t sid = segMap[seg.sid];
-	constraint[sid] = con;
+	// The keys set replace the shard's own, the rest it keeps or inherits
+	uint32_t sid = local(seg.sid);
+	auto found = constraint->find(sid);
+	cst::Table own;
+	if(found != constraint->end()) { own = *found->second; }
+	constraint.edit()[sid] = cst::merge(own, con);
+}
+
+void Layer::inherit(Constraint con)
+{
+	std::vector<Constraint> all = defaults->con;
+	all.push_back(con);
+	defaults = cst::table(all);
+}
+
+void Layer::save(ckpt::Writer& w, ckpt::Strings& names)
+{
+	w.vertices(vertex.flat());
+	w.varint(shard->size());
+	for(auto& sh : *shard) { w.varint(sh.sid); w.ids(sh.vid); }
+	w.idmap(*segMap);
+	w.idmap(*segRev);
+	w.ids(adjacency->start);
+	w.ids(adjacency->edge);
+	save_constraints(w, names, defaults->con);
+	w.varint(constraint->size());
+	for(auto & [sid,con] : *constraint)
+	{
+		w.varint(sid);
+		save_constraints(w, names, con->con);
+	}
+	w.relation(*logicRel);
+}
+
+bool Layer::load(ckpt::Reader& r, const std::vector<std::string>& names)
+{
+	vertex = r.vertices();
+	std::vector<segment> shards;
+	uint64_t count = r.varint();
+	for(uint64_t i = 0; r.good() && i < count; i++)
+	{
+		uint32_t sid = r.varint();
+		// Uids are not saved, loading starts them over
+		shards.push_back({sid, r.ids(), serial++});
+	}
+	shard = shards;
+	segMap = r.idmap();
+	segRev = r.idmap();
+	graph::CSR csr = {r.ids(), r.ids()};
+	std::vector<Constraint> inherited;
+	if(!load_constraints(r, names, inherited)) { return false; }
+	defaults = cst::table(inherited);
+	std::map<uint32_t,cow::Cow<cst::Table>> cons;
+	count = r.varint();
+	for(uint64_t i = 0; r.good() && i < count; i++)
+	{
+		uint32_t sid = r.varint();
+		std::vector<Constraint> own;
+		if(!load_constraints(r, names, own)) { return false; }
+		cons[sid] = cst::table(own);
+	}
+	constraint = cons;
+	logicRel = r.relation();
+	// Every shard must point into the vertex pool, every link to a shard
+	for(auto& sh : *shard)
+	{
+		for(auto v : sh.vid) { if(v >= vertex.size()) { return false; } }
+	}
+	if(graph::nodes(csr) > shard->size()) { return false; }
+	for(auto e : csr.edge) { if(e >= shard->size()) { return false; } }
+	for(uint32_t i = 1; i < csr.start.size(); i++)
+	{
+		if(csr.start[i] < csr.start[i-1]) { return false; }
+	}
+	if(csr.start.size() > 0 && csr.start.back() != csr.edge.size())
+	{
+		return false;
+	}
+	adjacency = csr;
+	return r.good();
 }
 
 // Workspace class definitions
-Workspace::Workspace(cairo_surface_t* can, std::vector<Vertex> boundary, double scale)
+Workspace::Workspace(
+	out::Output* can, std::vector<Vertex> boundary, double scale, uint64_t seed)
 {
 	// Store the canvas
 	const_canvas = can;
 	const_scale = scale;
-	// Create a random lambda that avoids the GODAMN BOILERPLATE!
-	// Because random is statefull we need a mutable tab
-	// This is bonkers but at least you CAN do bonkers stuff in C++
-	std::default_random_engine gen;
-	std::uniform_real_distribution<double> dis(0.0, 1.0);
-	auto S = std::chrono::system_clock::now().time_since_epoch().count();
-	std::cout << "SEED" << S << std::endl;
-	uint64_t seed = S;
+	const_size = {0.0, 0.0};
+	for(auto v : boundary)
+	{
+		const_size.x = v.x * scale > const_size.x ? v.x * scale : const_size.x;
+		const_size.y = v.y * scale > const_size.y ? v.y * scale : const_size.y;
+	}
+	// Seed the random stream everything else splits from
+	std::cout << "SEED" << seed << std::endl;
 	//uint64_t seed = 1675128892961642292;
 	//uint64_t seed = 1675709149732672750;
-	gen.seed(seed);
-	rand = [=]() mutable -> double { return dis(gen); };
+	rand = rng::Random(seed);
+	workers = par::concurrency();
+	batching = true;
+	stride = 1;
 	// Setup the background layer
 	background = addLayer(0,boundary);
 	// Ensure that we are immediately ready for all operations
@@ -237,37 +405,43 @@ Workspace::Workspace(cairo_surface_t* can, std::vector<Vertex> boundary, double
 }
 
 // Copy constructor
-Workspace::Workspace(const Workspace& base, cairo_surface_t* can)
+Workspace::Workspace(const Workspace& base, out::Output* can)
 {
 	const_canvas = can;
 	const_scale = base.const_scale;
+	const_size = base.const_size;
 	constraint = base.constraint;
 	oper = base.oper;
 	brush = base.brush;
-	// Create a random lambda that avoids the GODAMN BOILERPLATE!
-	// Because random is statefull we need a mutable tab
-	// This is bonkers but at least you CAN do bonkers stuff in C++
-	std::default_random_engine gen;
-	std::uniform_real_distribution<double> dis(0.0, 1.0);
-	auto S = std::chrono::system_clock::now().time_since_epoch().count();
-	std::cout << "SEED" << S << std::endl;
-	uint64_t seed = S;
-	//uint64_t seed = 1675128892961642292;
-	//uint64_t seed = 1675709149732672750;
-	gen.seed(seed);
-	rand = [=]() mutable -> double { return dis(gen); };
-	// Add all layers
+	// Carry on from the same point in the random stream
+	rand = base.rand;
+	workers = base.workers;
+	batching = base.batching;
+	stride = base.stride;
+	// Copy all layers, the copy owns its own but shares their storage
 	height = base.height;
-	background = base.background;
-	/*
 	for(auto it = base.layer.begin(); it != base.layer.end(); ++it)
 	{
-		layer[it->first] = it->second;
-		if(it->first == 0) { background = it->second; }
-	}*/
+		layer[it->first] = new Layer(*it->second);
+	}
+	background = layer[0];
 	logic = base.logic;
-	// Ensure we are ready
-	ensureReadyLayout();
+	op_cache = base.op_cache;
+	op_stats = base.op_stats;
+	op_ranks = base.op_ranks;
+	journal = base.journal;
+	layerBase = base.layerBase;
+	// Share the caches too, they are regenerated before they are drawn on
+	segment = base.segment;
+	linkIndex = base.linkIndex;
+	cutGraph = base.cutGraph;
+	uidIndex = base.uidIndex;
+}
+
+Workspace::~Workspace()
+{
+	for(auto it = layer.begin(); it != layer.end(); ++it) { delete it->second; }
+	layer.clear();
 }
 
 Layer* Workspace::addLayer(uint32_t h, std::vector<Vertex> boundary)
@@ -279,47 +453,70 @@ Layer* Workspace::addLayer(uint32_t h, std::vector<Vertex> boundary)
 	height.insert(i,h);
 	// Store the layer
 	layer[h] = ptr;
+	journal.push_back({Change::ADDED, Layer::uid(h, 0)});
 	return ptr;
 }
 
 bool Workspace::ensureReadyLayout()
 {
 	// Clear previous segment cache and recache everything
-	segment.clear();
-	// Clear previous link map cache
-	linkMap.clear();
+	segment = std::vector<Segment>();
+	auto& seg = segment.edit();
 	// Recache everything
+	layerBase.clear();
 	for(auto & [h,l] : layer)
 	{
+		layerBase[h] = seg.size();
 		for(auto s : l->recache(this, h, sidGen()))
 		{
-			segment.push_back(s);
+			seg.push_back(s);
 		}	
 	}
-	// Link all the segments
-	for(auto s : segment) { linkMap[s.sid] = {}; }
+	// Index the logical links both ways and group the segments they join
+	LinkIndex index;
+	index.member.resize(logic->size());
+	index.link.resize(seg.size());
+	index.group.grow(seg.size());
 	for(auto & [h,l] : layer)
 	{
-		for(auto link : logic)
+		for(auto & [lid,members] : l->logic())
 		{
-			for(auto sid : l->logic(link))
+			if(lid >= logic->size()) { continue; }
+			for(auto m : members)
 			{
-				linkMap[sid].insert(link);
+				uint32_t sid = layerBase[h] + m;
+				if(sid >= seg.size()) { continue; }
+				auto& in = index.member[lid];
+				if(in.size() > 0) { index.group.join(in[0], sid); }
+				in.push_back(sid);
+				index.link[sid].push_back(lid);
 			}
 		}
 	}
+	linkIndex = std::move(index);
+	// The edge adjacency of the whole cut, in segment ids
+	graph::CSR adj;
+	adj.start.push_back(0);
+	for(auto& s : seg)
+	{
+		for(auto sid : neighbours(s)) { adj.edge.push_back(sid); }
+		adj.start.push_back(adj.edge.size());
+	}
+	cutGraph = std::move(adj);
+	std::unordered_map<uint64_t,uint32_t> uids;
+	uids.reserve(seg.size());
+	for(auto& s : seg) { uids[s.uid] = s.sid; }
+	uidIndex = std::move(uids);
 	return true;
 }
 
-double Workspace::layoutStep(std::vector<double> zipfs)
+std::vector<Score> Workspace::layoutScores(std::vector<double> zipfs)
 {
-	if(!ensureReadyLayout()) { return false; };
-	// Find the best operator
-	std::vector<Callback> cand;
+	std::vector<Score> cand;
 	uint32_t z = 0;
-	for(auto o : oper)
+	for(auto& o : *oper)
 	{
-		Callback layout = o.layout(this, o);
+		Score layout = o.score(this, o);
 		layout.match *= zipfs[z]; // zipf's weighting!
 		cand.push_back(layout);
 		/*
@@ -330,13 +527,20 @@ double Workspace::layoutStep(std::vector<double> zipfs)
 		//*/
 		z++;
 	}
+	return cand;
+}
+
+double Workspace::layoutStep(std::vector<double> zipfs)
+{
+	if(!ensureReadyLayout()) { return false; };
+	// Score the operators
+	std::vector<Score> cand = layoutScores(zipfs);
 	// std::cout << "CAND " << cand.size() << std::endl;
 	// Pre breaking condition(s)
 	if(cand.size() == 0) { return 0.0; }
-	// Weighted choice only by match
-	Callback cb = weighted_choice(this, cand, 0.0);
-	// Run the operator if possible
-	if(cb.usable) { cb.callback(); }
+	// Weighted choice only by match, then run the chosen operator
+	int64_t pick = weighted_choice(this, cand, 0.0);
+	if(pick >= 0) { (*oper)[pick].layout(this, (*oper)[pick]); }
 	// Find the (new) threshold
 	double max = 0.0;
 	for(auto c : cand) { max = c.match > max ? c.match : max; }
@@ -344,44 +548,54 @@ double Workspace::layoutStep(std::vector<double> zipfs)
 	return max;
 }
 
-bool Workspace::addBrush(Brush b) { brush.push_back(b); return true; }
-bool Workspace::addOperator(Operator op) { oper.push_back(op); return true; }
-bool Workspace::addConstraint(Constraint con)
+std::vector<uint32_t> Workspace::layoutBest(
+	std::vector<double> zipfs, uint32_t count)
 {
-	constraint.push_back(con);
-	printf("ADDING CONSTRAINT %s, %d, %f\n",con.name.c_str(), con.mask, con.dial);
-	// Distribute the constraint to all segments in all layers
-	for(auto s : cut())
+	std::vector<uint32_t> ret;
+	if(!ensureReadyLayout()) { return ret; }
+	std::vector<Score> cand = layoutScores(zipfs);
+	for(uint32_t i = 0; i < cand.size(); i++)
 	{
-		Layer* l = layer[s.layer];
-		std::vector<Constraint> cons = s.constraint;
-		cons.push_back(con);
-		l->updateConstraint(s, cons);
+		if(cand[i].usable && cand[i].match > 0.0) { ret.push_back(i); }
 	}
+	// The moves wanted most first, ties by operator order
+	std::stable_sort(ret.begin(), ret.end(),
+		[&](uint32_t a, uint32_t b) { return cand[a].match > cand[b].match; });
+	if(ret.size() > count) { ret.resize(count); }
+	return ret;
+}
+
+bool Workspace::addBrush(Brush b) { brush.edit().push_back(b); return true; }
+bool Workspace::addOperator(Operator op)
+{
+	oper.edit().push_back(op);
+	return true;
+}
+bool Workspace::addConstraint(Constraint con)
+{
+	constraint.edit().push_back(con);
+	printf("ADDING CONSTRAINT %s, %d, %f\n",
+		cst::name(con.key).c_str(), con.mask, con.dial);
+	// Every segment on the layers so far inherits the constraint
+	for(auto & [h,l] : layer) { l->inherit(con); }
+	for(auto& s : *segment) { journal.push_back({Change::SET, s.uid}); }
 	// Update caches to perserve the change
 	ensureReadyLayout();
 	return true;
 }
 
 
-cairo_surface_t* makeSurface(std::string filename)
-{
-	cairo_surface_t* surface;
-	surface = cairo_svg_surface_create(filename.c_str(),1920,1080);
-	cairo_svg_surface_restrict_to_version(surface, CAIRO_SVG_VERSION_1_2);
-	cairo_svg_surface_set_document_unit(surface, CAIRO_SVG_UNIT_PX);
-	return surface;
-}
-
 bool Workspace::runTempere(uint32_t steps,bool debug)
 {
 	// Run a certain amount of layout steps
 	// Zipf's weighting for operators
-	std::vector<double> zipfs = zipfs_weight(this, oper.size());
+	std::vector<double> zipfs = zipfs_weight(this, oper->size());
 	
 	double threshold = -1.0;
 	double min = -1.0;
 	uint32_t step = 0;
+	// Snapshots are copied here and drawn by a writer in the background
+	par::Worker writer(4);
 	while(threshold == -1.0 || min == -1.0 || min < threshold)
 	{
 		// Break at the hardcoded step limit
@@ -391,62 +605,174 @@ bool Workspace::runTempere(uint32_t steps,bool debug)
 		threshold = layoutStep(zipfs);
 		min = min == -1 ? 0.0 : min + 0.01;
 		// If we are in debug code, render step
-		if(debug) {
+		if(debug && step % stride == 0) {
 			printf("Stop values %f,%f\n",min,threshold);
 			// Make a snapshot image
 			std::string output = "./debug/DebugStep" + std::to_string(step) + ".svg";
-			printf(output.c_str());
-			cairo_surface_t* srfc = makeSurface(output);
+			printf("%s\n",output.c_str());
+			out::Output* srfc = new out::Output(
+				out::BACKEND::SVG, output, const_size.x, const_size.y);
 			Workspace* snap = new Workspace(*this,srfc);
-			snap->renderDebug();
+			writer.push([=]()
+			{
+				snap->renderDebug();
+				srfc->finish();
+				delete snap;
+				delete srfc;
+			});
 		}
 	}
 	return true;
 }
 
-std::vector<Segment> Workspace::cut() { return segment; }
+double Workspace::layoutScore(std::vector<double> zipfs)
+{
+	if(!ensureReadyLayout()) { return 0.0; }
+	// Operators draw from a scratch stream so scoring leaves ours alone
+	rng::Random scratch = rand.split((uint64_t)-1);
+	rng::Scope scope(&scratch);
+	double max = 0.0;
+	uint32_t z = 0;
+	for(auto& o : *oper)
+	{
+		double match = o.score(this, o).match * zipfs[z];
+		max = match > max ? match : max;
+		z++;
+	}
+	return max;
+}
+
+Workspace* Workspace::runBeam(uint32_t steps, uint32_t width, uint32_t fan)
+{
+	width = width == 0 ? 1 : width;
+	fan = fan == 0 ? 1 : fan;
+	std::vector<double> zipfs = zipfs_weight(this, oper->size());
+	std::vector<Workspace*> beam = {new Workspace(*this, const_canvas)};
+	double threshold = -1.0;
+	double min = -1.0;
+	uint32_t step = 0;
+	while(threshold == -1.0 || min == -1.0 || min < threshold)
+	{
+		if(!(steps == (uint32_t)-1) && step >= steps) { break; }
+		else { step += 1; }
+		// Every branch is scored, then forks on its fan best operators
+		std::vector<std::vector<uint32_t>> best(beam.size());
+		par::parallel_for(beam.size(), workers, [&](uint32_t b)
+		{
+			best[b] = beam[b]->layoutBest(zipfs, fan);
+		});
+		// A fork is a branch, an operator and its stream. The fan forks go
+		// round the best operators, so each is tried and the spare forks
+		// try the best again on other streams. Branches with nothing usable
+		// are carried on as they are.
+		std::vector<std::tuple<uint32_t,int64_t,uint32_t>> fork;
+		for(uint32_t b = 0; b < beam.size(); b++)
+		{
+			if(best[b].size() == 0) { fork.push_back({b, -1, 0}); continue; }
+			for(uint32_t k = 0; k < fan; k++)
+			{
+				fork.push_back({b, best[b][k % best[b].size()], k});
+			}
+		}
+		uint32_t N = fork.size();
+		std::vector<Workspace*> child(N, NULL);
+		std::vector<double> score(N, 0.0);
+		par::parallel_for(N, workers, [&](uint32_t i)
+		{
+			auto [b, op, k] = fork[i];
+			Workspace* parent = beam[b];
+			child[i] = new Workspace(*parent, const_canvas);
+			child[i]->rand = parent->rand.split(k);
+			Workspace* c = child[i];
+			if(op >= 0) { (*c->oper)[op].layout(c, (*c->oper)[op]); }
+			score[i] = child[i]->layoutScore(zipfs);
+		});
+		for(auto b : beam) { delete b; }
+		// A match is how much an operator still wants to act, so forks take
+		// the moves wanted most and keep the branches that leave the least
+		// wanted afterwards. runTempere stops on the same measure, once the
+		// highest match falls under its rising floor. Ties by fork order.
+		std::vector<uint32_t> order;
+		for(uint32_t i = 0; i < N; i++) { order.push_back(i); }
+		std::stable_sort(order.begin(), order.end(),
+			[&](uint32_t a, uint32_t b) { return score[a] < score[b]; });
+		beam.clear();
+		for(uint32_t i = 0; i < N; i++)
+		{
+			if(i < width) { beam.push_back(child[order[i]]); }
+			else { delete child[order[i]]; }
+		}
+		threshold = score[order[0]];
+		min = min == -1 ? 0.0 : min + 0.01;
+		printf("Beam step %u kept %zu of %u, best %f\n",
+			step, beam.size(), N, threshold);
+	}
+	// The first branch is the best one
+	for(uint32_t i = 1; i < beam.size(); i++) { delete beam[i]; }
+	return beam[0];
+}
+
+std::vector<Segment> Workspace::cut() { return *segment; }
 std::set<Segment> Workspace::geomRel(Segment s)
 {
 	std::set<Segment> ret;
-	for(auto sid : layer[s.layer]->geom(s)) { ret.insert(segment[sid]); }
+	for(auto sid : neighbours(s)) { ret.insert((*segment)[sid]); }
 	return ret;
 }
+const Segment* Workspace::find(uint64_t uid)
+{
+	auto found = uidIndex->find(uid);
+	if(found == uidIndex->end()) { return NULL; }
+	return &(*segment)[found->second];
+}
+
+graph::Range Workspace::neighbours(const Segment& s)
+{
+	auto l = layer.find(s.layer);
+	auto base = layerBase.find(s.layer);
+	if(l == layer.end() || base == layerBase.end()) { return graph::Range(); }
+	if(s.sid < base->second) { return graph::Range(); }
+	return l->second->neighbours(s.sid - base->second, base->second);
+}
 std::set<Segment> Workspace::logicRel(Segment s)
 {
 	std::set<Segment> out;
-	// All the links from this segment
-	for(auto link : linkMap[s.sid])
+	// All the segments in all the links from this segment
+	if(s.sid >= linkIndex->link.size()) { return out; }
+	for(auto link : linkIndex->link[s.sid])
 	{
-		// Find all the segmentids from these links
-		for(auto & [h,l] : layer)
+		for(auto sid : linkIndex->member[link])
 		{
-			for(auto sid : l->logic(link))
-			{
-				out.insert(segment[sid]);
-			}
+			out.insert((*segment)[sid]);
 		}
 	}
 	return out;
 }
 
+std::vector<uint32_t> Workspace::logicGroup(const Segment& s)
+{
+	if(s.sid >= linkIndex->link.size()) { return {s.sid}; }
+	return linkIndex->group.members(s.sid);
+}
+
 void Workspace::linkSegment(Operator op, Segment head, Segment tail)
 {
 	// Check if operator is allowed TODO: this
-	for(auto o : oper) { if(o.name == op.name) { printf(" "); } }
-	// Check if there is a link between the two already
-	auto H = linkMap[head.sid];
-	auto T = linkMap[tail.sid];
-	std::set<uint32_t> I;
-	std::set_intersection(
-		H.begin(),H.end(),
-		T.begin(),T.end(),
-		std::inserter(I,I.begin()));
-	if(I.size() > 0) { return; }
+	for(auto& o : *oper) { if(o.name == op.name) { printf(" "); } }
+	// Segments already joined through any chain of links need no new one
+	auto& index = linkIndex.edit();
+	uint32_t top = std::max(head.sid, tail.sid) + 1;
+	if(index.link.size() < top) { index.link.resize(top); }
+	index.group.grow(top);
+	if(!index.group.join(head.sid, tail.sid)) { return; }
 	// Otherwise just make a new link
-	uint32_t newlid = logic.size();
-	logic.push_back(newlid);
-	layer[head.layer]->linkLogical(head,newlid);
-	layer[tail.layer]->linkLogical(tail,newlid);
+	uint32_t newlid = logic->size();
+	logic.edit().push_back(newlid);
+	index.member.push_back({head.sid, tail.sid});
+	index.link[head.sid].push_back(newlid);
+	index.link[tail.sid].push_back(newlid);
+	layer[head.layer]->linkLogical(head.sid - layerBase[head.layer], newlid);
+	layer[tail.layer]->linkLogical(tail.sid - layerBase[tail.layer], newlid);
 }
 
 void Workspace::addSegment(
@@ -458,7 +784,7 @@ void Workspace::addSegment(
 	// Test if the segment is (fully, open set) within another
 	auto checkbounce = [=](uint32_t lid) -> bool
 	{
-		for(auto seg : segment)
+		for(auto& seg : *segment)
 		{
 			// We are looking for an open interior except for point
 			bool open = bound.size() < 2;
@@ -474,15 +800,20 @@ void Workspace::addSegment(
 	if(!layer.count(lid))
 	{
 		// printf("New layer with lid %i\n",lid);
-		layer[lid] = new Layer(bound);
+		addLayer(lid, bound);
 		return;
 	}
 	// If there is already a layer here, we must do tempere on the layer
-	layer[lid]->tempere(bound);
+	std::vector<Change> change;
+	layer[lid]->tempere(bound, change);
+	for(auto c : change)
+	{
+		journal.push_back({c.kind, Layer::uid(lid, c.uid)});
+	}
 	// Mark the created segment(s) and recache them
 	for(auto s : layer[lid]->unmappedSegment(this,lid,sidGen()))
 	{
-		op_cache[op][s] = mark;
+		op_cache[op].edit()[s] = mark;
 	}
 	// Then recache them
 	// layer[lid]->recache(this, lid, sidGen());
@@ -495,6 +826,125 @@ void Workspace::setConstraint(
 	uint32_t lid = seg.layer;
 	Layer* lay = layer[lid];
 	lay->updateConstraint(seg, con);
+	journal.push_back({Change::SET, seg.uid});
+}
+
+bool Workspace::saveLayout(std::string filename)
+{
+	// Save the recached state a load will restore
+	ensureReadyLayout();
+	ckpt::Strings names;
+	std::vector<ckpt::Section> file;
+	// Workspace wide state first, then one section per layer height
+	ckpt::Section ws = {ckpt::SECTION::WORKSPACE, 0, {}};
+	ws.data.real(const_scale);
+	ws.data.real(const_size.x);
+	ws.data.real(const_size.y);
+	for(int i = 0; i < 4; i++) { ws.data.fixed(rand.state()[i]); }
+	save_constraints(ws.data, names, *constraint);
+	ws.data.ids(height);
+	ws.data.ids(*logic);
+	// Operator marks are kept by operator name and segment id
+	ws.data.varint(op_cache.size());
+	for(auto & [op,marks] : op_cache)
+	{
+		std::map<uint32_t,uint32_t> bysid;
+		for(auto & [s,mark] : *marks) { bysid[s.sid] = mark; }
+		ws.data.varint(names.intern(op.name));
+		ws.data.idmap(bysid);
+	}
+	file.push_back(ws);
+	for(auto & [h,l] : layer)
+	{
+		ckpt::Section sec = {ckpt::SECTION::LAYER, h, {}};
+		l->save(sec.data, names);
+		file.push_back(sec);
+	}
+	ckpt::Section str = {ckpt::SECTION::STRINGS, 0, {}};
+	str.data.varint(names.all().size());
+	for(auto& n : names.all()) { str.data.string(n); }
+	file.insert(file.begin(), str);
+	return ckpt::write(filename, file);
+}
+
+bool Workspace::loadLayout(std::string filename)
+{
+	ckpt::Map map(filename);
+	if(!map.good()) { return false; }
+	ckpt::Reader str = map.section(ckpt::SECTION::STRINGS, 0);
+	std::vector<std::string> names;
+	uint64_t count = str.varint();
+	for(uint64_t i = 0; str.good() && i < count; i++)
+	{
+		names.push_back(str.string());
+	}
+	if(!str.good()) { return false; }
+	// Read everything aside, the workspace is only changed if all of it loads
+	ckpt::Reader ws = map.section(ckpt::SECTION::WORKSPACE, 0);
+	double scale = ws.real();
+	Vertex size = {ws.real(), ws.real()};
+	uint64_t state[4];
+	for(int i = 0; i < 4; i++) { state[i] = ws.fixed(); }
+	std::vector<Constraint> con;
+	if(!load_constraints(ws, names, con)) { return false; }
+	// Heights are saved but rebuilt from the layer sections below
+	ws.ids();
+	std::vector<uint32_t> links = ws.ids();
+	std::map<std::string,std::map<uint32_t,uint32_t>> marks;
+	uint64_t ops = ws.varint();
+	for(uint64_t i = 0; ws.good() && i < ops; i++)
+	{
+		uint64_t name = ws.varint();
+		if(name >= names.size()) { return false; }
+		marks[names[name]] = ws.idmap();
+	}
+	if(!ws.good()) { return false; }
+	std::map<uint32_t,Layer*> layers;
+	bool ok = true;
+	for(auto h : map.keys(ckpt::SECTION::LAYER))
+	{
+		ckpt::Reader r = map.section(ckpt::SECTION::LAYER, h);
+		Layer* l = new Layer({});
+		layers[h] = l;
+		ok = ok && l->load(r, names);
+	}
+	ok = ok && layers.count(0);
+	if(!ok)
+	{
+		for(auto & [h,l] : layers) { delete l; }
+		return false;
+	}
+	// Swap in the loaded layout
+	for(auto & [h,l] : layer) { delete l; }
+	layer = layers;
+	background = layer[0];
+	// Heights follow the layers, older files may have missed some
+	height.clear();
+	for(auto & [h,l] : layer) { height.push_back(h); }
+	logic = links;
+	constraint = con;
+	const_scale = scale;
+	const_size = size;
+	rand.restore(state);
+	ensureReadyLayout();
+	// Uids start over, so statistics kept on them do too
+	journal = cow::Chunks<Change>();
+	op_stats.clear();
+	op_ranks.clear();
+	// Marks are keyed by segment, match them to the recached segments
+	op_cache.clear();
+	for(auto& o : *oper)
+	{
+		if(!marks.count(o.name)) { continue; }
+		for(auto & [sid,mark] : marks[o.name])
+		{
+			Segment key;
+			if(sid < segment->size()) { key = (*segment)[sid]; }
+			else { key.sid = sid; }
+			op_cache[o].edit()[key] = mark;
+		}
+	}
+	return true;
 }
 
 bool Workspace::ensureReadyRender()
@@ -508,24 +958,30 @@ bool Workspace::ensureReadyRender()
 
 std::vector<Callback> Workspace::drawSegment(Segment s, std::vector<double> z)
 {
-	// Arrange candidates in priority order
-	std::vector<Callback> cand;
+	// Score the brushes, only chosen ones prepare their drawing
+	std::vector<Score> cand;
 	uint32_t zid = 0;
-	for(auto b : brush)
+	for(auto& b : *brush)
 	{
-		Callback draw = b.draw(this, s, b);
+		Score draw = b.score(this, s, b);
 		draw.match *= z[zid]; // zipf's weighting!
 		cand.push_back(draw);
 		zid++;
 	}
+	auto materialize = [&](int64_t i) -> Callback
+	{
+		return {true, cand[i].match, cand[i].priority,
+			(*brush)[i].draw(this, s, (*brush)[i])};
+	};
 	// The callbacks to completed drawing lambdas
 	std::vector<Callback> ret;
 	// Breaking condition
 	if(cand.size() == 0) { return ret; }
-	// Weighted choice only by match
-	Callback cb = weighted_choice(this, cand, 0.0);
-	if(!cb.usable) { return ret; }
-	ret.push_back(cb);
+	// Weighted choice only by match, from one sampler for all the draws
+	smp::Weighted sampler = score_sampler(cand);
+	int64_t pick = sampler.draw(0.0, rand());
+	if(pick < 0) { return ret; }
+	ret.push_back(materialize(pick));
 	// Additional draws weighted by priority
 	// TODO: allow brushes to indicate a probability of being done after
 	// running once. This will allow multiple brushes on the same segment
@@ -533,13 +989,13 @@ std::vector<Callback> Workspace::drawSegment(Segment s, std::vector<double> z)
 	double adjust = 1.0;
 	double r = rand();
 	uint32_t drawnum = 0;
-	while(r < ((1.0-cb.priority) * adjust))
+	while(r < ((1.0-cand[pick].priority) * adjust))
 	{
 		// printf("Rand %f\n",r);
-		cb = weighted_choice(this, cand, adjust);
-		// printf("Usable %s\n",cb.usable ? "true" : "false");
-		if(!cb.usable) { break; }
-		ret.push_back(cb);
+		pick = sampler.draw(adjust, rand());
+		// printf("Usable %s\n",pick >= 0 ? "true" : "false");
+		if(pick < 0) { break; }
+		ret.push_back(materialize(pick));
 		adjust *= 0.95;
 		r = rand();
 		drawnum++;
@@ -556,6 +1012,7 @@ bool Workspace::renderDebug()
 		return false;
 	} 
 	// Draw the background in solid colors, with border
+	const_record.clear();
 	std::vector<Segment> seg = cut();
 	printf("There are %i total segments",seg.size());
 	for(auto s : seg)
@@ -563,20 +1020,198 @@ bool Workspace::renderDebug()
 		if(s.layer == 0)
 		{
 			// printf("BACKGROUND SEGMENT %d\n",s.sid);
-			solid_brush.draw(this,s,solid_brush).callback();
+			solid_brush.draw(this,s,solid_brush)();
 		}
 	}
 	// Draw the logical connections
 	// TODO: implement
 	// Draw the local connections
 	// TODO: implement
+	playRecord();
+	return true;
+}
+
+void Workspace::setWorkers(uint32_t num) { workers = num == 0 ? 1 : num; }
+void Workspace::setStride(uint32_t k) { stride = k > 0 ? k : 1; }
+void Workspace::setBatching(bool batch) { batching = batch; }
+
+bool Workspace::playLayers(const std::vector<rec::Buffer>& part)
+{
+	// Vector outputs keep every path, so they play the one record in order.
+	// Layers go one or more to a worker when there are enough to keep every
+	// worker busy, otherwise tiles split the canvas more evenly.
+	if(!raster() || workers < 2 || part.size() < workers)
+	{
+		return playRecord();
+	}
+	// Each layer is drawn onto its own transparent image on a worker
+	double zoom = const_canvas->width() / const_size.x;
+	uint32_t w = const_canvas->width();
+	uint32_t h = const_canvas->height();
+	std::vector<cairo_surface_t*> group(part.size());
+	std::vector<uint32_t> paths(part.size(), 0);
+	par::parallel_for(part.size(), workers, [&](uint32_t i) -> void
+	{
+		group[i] = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+		if(batching)
+		{
+			rec::Buffer sorted = part[i].batched(64);
+			paths[i] = rec::play(sorted, group[i], true, zoom);
+		}
+		else { paths[i] = rec::play(part[i], group[i], false, zoom); }
+	});
+	// Then composited over the canvas from the bottom layer up
+	cairo_t* drawer = cairo_create(const_canvas->surface());
+	uint32_t total = 0;
+	for(uint32_t i = 0; i < group.size(); i++)
+	{
+		cairo_set_source_surface(drawer, group[i], 0.0, 0.0);
+		cairo_paint(drawer);
+		cairo_surface_destroy(group[i]);
+		total += paths[i];
+	}
+	cairo_destroy(drawer);
+	printf("Played %zu draw commands as %u paths on %zu layers\n",
+		const_record.size(), total, part.size());
+	return true;
+}
+
+bool Workspace::raster()
+{
+	// Whole images only, banded canvases hold a band at a time
+	out::BACKEND b = const_canvas->backend();
+	bool image = b == out::BACKEND::PNG || b == out::BACKEND::RGBA;
+	return image && const_canvas->band() == 0;
+}
+
+uint32_t Workspace::tiles()
+{
+	uint32_t cols = (const_canvas->width() + TILE - 1) / TILE;
+	uint32_t rows = (const_canvas->height() + TILE - 1) / TILE;
+	return cols * rows;
+}
+
+uint32_t Workspace::playRegion(
+	const rec::Buffer& play,
+	const std::vector<rec::Box>& bounds,
+	cairo_surface_t* surface,
+	uint32_t y0,
+	uint32_t h)
+{
+	// Each tile is a surface over its own rectangle of the image memory,
+	// so workers draw straight into the image and nothing is stitched
+	cairo_surface_flush(surface);
+	unsigned char* data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	double zoom = const_canvas->width() / const_size.x;
+	uint32_t w = const_canvas->width();
+	uint32_t cols = (w + TILE - 1) / TILE;
+	uint32_t rows = (h + TILE - 1) / TILE;
+	std::vector<uint32_t> paths(cols * rows, 0);
+	par::parallel_for(cols * rows, workers, [&](uint32_t t) -> void
+	{
+		uint32_t tx = (t % cols) * TILE;
+		uint32_t ty = (t / cols) * TILE;
+		uint32_t tw = std::min(TILE, w - tx);
+		uint32_t th = std::min(TILE, h - ty);
+		// The tile in record pixels, with a canvas pixel of slack. Tiles
+		// only replay the commands whose bounds reach them.
+		double top = y0 + ty;
+		rec::Box window =
+		{
+			(tx - 1.0) / zoom, (top - 1.0) / zoom,
+			(tx + tw + 1.0) / zoom, (top + th + 1.0) / zoom
+		};
+		auto pick = rec::touching(play, bounds, window);
+		cairo_surface_t* tile = cairo_image_surface_create_for_data(
+			data + (size_t)ty * stride + tx * 4,
+			CAIRO_FORMAT_ARGB32, tw, th, stride);
+		Vertex origin = {(double)tx, top};
+		paths[t] = rec::play(play, pick, tile, batching, zoom, origin);
+		cairo_surface_destroy(tile);
+	});
+	cairo_surface_mark_dirty(surface);
+	uint32_t total = 0;
+	for(auto p : paths) { total += p; }
+	return total;
+}
+
+bool Workspace::playTiles(const rec::Buffer& record)
+{
+	rec::Buffer sorted;
+	if(batching) { sorted = record.batched(64); }
+	const rec::Buffer& play = batching ? sorted : record;
+	uint32_t paths = playRegion(
+		play, play.bounds(), const_canvas->surface(),
+		0, const_canvas->height());
+	printf("Played %zu draw commands as %u paths on %u tiles\n",
+		record.size(), paths, tiles());
+	return true;
+}
+
+bool Workspace::playBands(const rec::Buffer& record)
+{
+	// The canvas holds one band, drawn, streamed out and cleared in turn,
+	// so memory does not grow with the height of the picture
+	rec::Buffer sorted;
+	if(batching) { sorted = record.batched(64); }
+	const rec::Buffer& play = batching ? sorted : record;
+	std::vector<rec::Box> bounds = play.bounds();
+	cairo_surface_t* band = const_canvas->surface();
+	uint32_t rows = const_canvas->band();
+	uint32_t h = const_canvas->height();
+	uint32_t stride = cairo_image_surface_get_stride(band);
+	uint32_t paths = 0;
+	uint32_t count = 0;
+	for(uint32_t y0 = 0; y0 < h; y0 += rows, count++)
+	{
+		uint32_t bh = std::min(rows, h - y0);
+		cairo_surface_flush(band);
+		memset(cairo_image_surface_get_data(band), 0, (size_t)stride * rows);
+		cairo_surface_mark_dirty(band);
+		paths += playRegion(play, bounds, band, y0, bh);
+		if(!const_canvas->stream(bh)) { return false; }
+		printf("\rStreamed %u of %u rows...", y0 + bh, h);
+		fflush(stdout);
+	}
+	printf("\nPlayed %zu draw commands as %u paths on %u bands\n",
+		record.size(), paths, count);
+	return true;
+}
+
+bool Workspace::playRecord()
+{
+	// Banded canvases stream out band by band, whole raster canvases of
+	// more than a tile are drawn by tile on workers
+	if(const_canvas->band() > 0) { return playBands(const_record); }
+	if(raster() && workers > 1 && tiles() > 1)
+	{
+		return playTiles(const_record);
+	}
+	// Play the record back onto the canvas, merged by paint if batching.
+	// The record is in pixels at scale, zoom it to the canvas resolution.
+	double zoom = const_canvas->width() / const_size.x;
+	uint32_t paths = 0;
+	if(batching)
+	{
+		rec::Buffer sorted = const_record.batched(64);
+		paths = rec::play(sorted, const_canvas->surface(), true, zoom);
+	}
+	else
+	{
+		paths = rec::play(const_record, const_canvas->surface(), false, zoom);
+	}
+	printf("Played %zu draw commands as %u paths\n",
+		const_record.size(), paths);
+	return true;
 }
 
 bool Workspace::render()
 {
 	// Ensure all layers are segmented properly
 	if(!ensureReadyRender()) { return false;  }
-	// Draw all the segments!
+	// Draw all the segments into a fresh record
+	const_record.clear();
 	std::vector<Segment> seg = cut();
 	// Draw the background in solid colors
 	for(auto s : seg)
@@ -584,33 +1219,45 @@ bool Workspace::render()
 		if(s.layer == 0)
 		{
 			// printf("BACKGROUND SEGMENT %d\n",s.sid);
-			solid_brush.draw(this,s,solid_brush).callback();
+			solid_brush.draw(this,s,solid_brush)();
 		}
 	}
 	// Zipfs weighting for brushes
-	std::vector<double> zipfs = zipfs_weight(this, brush.size());
-	// Draw by layer
-	std::vector<Callback> frozen;
+	std::vector<double> zipfs = zipfs_weight(this, brush->size());
+	if(zipfs.size() == 0) { return playRecord(); }
+	// Evaluate the brushes for every segment in parallel, freezing the
+	// chosen callbacks in priority order
+	std::vector<std::vector<Callback>> frozen(seg.size());
+	// Every segment draws from its own sub-stream, so the result does not
+	// depend on which worker picks the segment up, or in what order.
+	par::parallel_for(seg.size(), workers, [&](uint32_t i) -> void
+	{
+		rng::Random stream = rand.split(i);
+		rng::Scope scope(&stream);
+		for(auto cb : drawSegment(seg[i], zipfs))
+		{
+			insertsort(frozen[i], cb);
+		}
+	});
+	// Replay the frozen callbacks by layer, then in priority order. Each
+	// layer gets its own record, the background goes with the first.
+	std::vector<rec::Buffer> part;
 	for(auto h : height)
 	{
-		for(auto s : seg)
+		for(uint32_t i = 0; i < seg.size(); i++)
 		{
-			if(s.layer == h && zipfs.size() > 0)
-			{
-				frozen.clear();
-				printf("\rDrawing Segment %d...",s.sid);
-				fflush(stdout);
-				for(auto cb : drawSegment(s, zipfs))
-				{
-					insertsort(frozen, cb);
-				}
-				// Call drawbacks for segment in prio order
-				for(auto cb : frozen) { cb.callback(); }
-			}
+			if(seg[i].layer != h) { continue; }
+			printf("\rDrawing Segment %d...",seg[i].sid);
+			fflush(stdout);
+			for(auto cb : frozen[i]) { cb.callback(); }
 		}
+		part.push_back(std::move(const_record));
+		const_record.clear();
 	}
 	printf("\n");
-	return true;
+	// Keep the whole record too, in drawing order
+	for(auto& p : part) { const_record.append(p); }
+	return playLayers(part);
 }
 
 void init_constraints(Workspace* ws)
@@ -630,78 +1277,90 @@ void init_constraints(Workspace* ws)
 	};
 	auto zipfs = zipfs_weight(ws, constraint.size());
 	// Make a zipfs for each item
+	dst::Block dials;
 	for(uint32_t i = 0; i < constraint.size(); i++)
 	{
-		ws->addConstraint(constraint[i].create(zipfs[i],ws->rand));
+		ws->addConstraint(constraint[i].create(zipfs[i],ws->rand,dials));
 	}
 }
 
 
-void init_workspace(Workspace* ws)
+// The operators and brushes every workspace starts from. The tables are built
+// once and only read, so workspaces on many threads share them.
+const std::vector<Operator>& operator_table()
 {
 	// Operators are found in the operators.h file!
-	std::vector<Operator> oper = 
+	static const std::vector<Operator> table =
 	{
 		symmetry_operator,
-		//figure_and_ground_operator,
+		figure_and_ground_operator,
 		//focal_point_operator,
 		//gradient_operator
 	};
-	for(auto op : oper) { ws->addOperator(op); }
+	return table;
+}
+
+const std::vector<Brush>& brush_table()
+{
 	// Brushes are found in the brushes.h file!
-	std::vector<Brush> brush =
+	static const std::vector<Brush> table =
 	{
 		solid_brush,
 		// shape_brush,
 		// line_brush,
 		specularhighlight_brush
 	};
-	for(auto br : brush) { ws->addBrush(br); }
+	return table;
+}
+
+void init_workspace(Workspace* ws)
+{
+	for(auto& op : operator_table()) { ws->addOperator(op); }
+	for(auto& br : brush_table()) { ws->addBrush(br); }
 	// Initialize the constraints
 	init_constraints(ws);
 }
 
-// TODO: binary search (probably last optimization to do xD)
-Callback weighted_choice(Workspace* ws, std::vector<Callback> cbs, double d)
+// Candidates are weighted by how well they match the workspace
+smp::Weighted score_sampler(const std::vector<Score>& cand)
 {
-	// Weight the choice by how well it matches the workspace
-	auto weight = [=](Callback c) -> double
-	{
-		return (c.match);
-	};
-	std::vector<Callback> cand;
-	for(auto cb : cbs)
-	{
-		//std::cout << cb.priority << " " << weight(cb) << std::endl;
-		if(cb.usable && (weight(cb) > d)) { cand.push_back(cb); }
-	}
-	// std::cout << "CLEANED CANDIDATES " << cand.size() << std::endl;
-	double sum = 0.0;
-	for(auto c : cand) { sum += weight(c); }
-	double pick = sum * ws->rand();
-	for(auto c : cand)
+	std::vector<double> weight;
+	std::vector<bool> usable;
+	for(auto& c : cand)
 	{
-		pick -= weight(c);
-		if(pick <= 0) { return c; }
+		weight.push_back(c.match);
+		usable.push_back(c.usable);
 	}
-	return {false, 0.0, 0.0, NULL};
+	return smp::Weighted(weight, usable);
 }
 
-void save_picture(cairo_surface_t* surface, std::string filename)
+int64_t weighted_choice(Workspace* ws, const std::vector<Score>& cand, double d)
 {
-	printf("Saving to %s\n",filename.c_str());
-	cairo_surface_finish(surface);
-	cairo_surface_destroy(surface);
-	// cairo_surface_write_to_png(svg,filename.c_str());
-	// cairo_surgace_write_to_svg(canvas,filename.c_str());
+	return score_sampler(cand).draw(d, ws->rand());
+}
+
+void save_picture(out::Output* canvas)
+{
+	printf("Saving to %s\n",canvas->filename().c_str());
+	if(!canvas->finish()) { printf("Failed to save!\n"); return; }
+	if(canvas->backend() == out::BACKEND::RGBA)
+	{
+		printf("Kept %u x %u RGBA pixels\n",canvas->width(),canvas->height());
+		return;
+	}
+	struct stat info;
+	if(stat(canvas->filename().c_str(), &info) == 0)
+	{
+		printf("Saved %lld bytes\n", (long long)info.st_size);
+	}
 }
 
 #ifdef TEST_RENDER
-void test_render(std::string filename, bool debug)
+// A fresh workspace with operators and brushes, ready for layout
+Workspace* make_draft(out::Output* surface, uint64_t seed)
 {
 	// The beggining boundary is just all edges!
-	// Default aspect ratio is 16:9, or 1920 x 1080
-	cairo_surface_t* surface = makeSurface(filename);
+	// Default aspect ratio is 16:9, or 1920 x 1080 at scale
 	std::vector<Vertex> boundary = {
 		{0.0,0.0},
 		{16.0,0.0},
@@ -709,42 +1368,245 @@ void test_render(std::string filename, bool debug)
 		{0.0,9.0}};
 	double scale = 120.0;
 	// TODO: maybe resolution choice?
-	Workspace* draft = new Workspace(surface,boundary,scale);
+	Workspace* draft = new Workspace(surface,boundary,scale,seed);
 	// Initialize operators and brushes
 	init_workspace(draft);
+	return draft;
+}
+
+void test_render(
+	out::Output* surface,
+	uint64_t seed,
+	bool debug,
+	uint32_t workers,
+	bool batching,
+	uint32_t stride,
+	uint32_t beam,
+	uint32_t fan,
+	int steps,
+	std::string load,
+	std::string save)
+{
+	Workspace* draft = make_draft(surface,seed);
+	if(workers > 0) { draft->setWorkers(workers); }
+	draft->setBatching(batching);
+	draft->setStride(stride);
+	// Resume from a saved layout, which only continues when asked to
+	if(load != "")
+	{
+		auto start = std::chrono::steady_clock::now();
+		if(!draft->loadLayout(load))
+		{
+			printf("Could not load layout from %s\n", load.c_str());
+			delete draft;
+			return;
+		}
+		std::chrono::duration<double> took =
+			std::chrono::steady_clock::now() - start;
+		printf("Loaded layout in %fs\n", took.count());
+		if(steps < 0) { steps = 0; }
+	}
 	// Run the tempere algorithm to completion
 	//draft->runTempere(-1);
 	//draft->runTempere(8);
 	//draft->runTempere(6);
-	draft->runTempere(110,debug);
+	if(steps < 0) { steps = 110; }
+	if(steps > 0 && beam > 0)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Workspace* best = draft->runBeam(steps, beam, fan);
+		std::chrono::duration<double> took =
+			std::chrono::steady_clock::now() - start;
+		printf("Beam searched in %fs\n", took.count());
+		delete draft;
+		draft = best;
+	}
+	else if(steps > 0) { draft->runTempere(steps,debug); }
+	if(save != "")
+	{
+		if(draft->saveLayout(save))
+		{
+			struct stat info;
+			stat(save.c_str(), &info);
+			printf("Saved layout in %lld bytes\n", (long long)info.st_size);
+		}
+		else { printf("Could not save layout to %s\n", save.c_str()); }
+	}
 	// Render the picture to a canvas
+	auto start = std::chrono::steady_clock::now();
 	draft->render();
+	std::chrono::duration<double> took =
+		std::chrono::steady_clock::now() - start;
+	printf("Rendered in %fs\n", took.count());
 	// Save the picture to a file.
-	save_picture(surface, filename);
+	save_picture(surface);
+	delete draft;
 	// A happy little message that everything is fine :)
 	printf("Hello World~\n");
 }
 
+// The placeholder a batch filename pattern takes the seed in
+const std::string SEED = "%llu";
+
+// Each picture needs its own file, so the seed must appear exactly once
+bool seed_pattern(const std::string& pattern)
+{
+	size_t at = pattern.find(SEED);
+	if(at == std::string::npos) { return false; }
+	return pattern.find(SEED, at + SEED.size()) == std::string::npos;
+}
+
+// The pattern is not a format, anything else in it is kept as written
+std::string seed_name(const std::string& pattern, uint64_t seed)
+{
+	std::string ret = pattern;
+	ret.replace(ret.find(SEED), SEED.size(), std::to_string(seed));
+	return ret;
+}
+
+// Render count pictures for the seeds following seed, one workspace per
+// picture. Workers take whole pictures, so each render runs on one thread.
+// The pattern holds the seed once, as in image_%llu.png
+void test_batch(
+	std::string pattern,
+	out::BACKEND backend,
+	uint32_t width,
+	uint32_t height,
+	uint64_t seed,
+	uint32_t count,
+	uint32_t workers,
+	bool batching)
+{
+	if(workers == 0) { workers = par::concurrency(); }
+	auto start = std::chrono::steady_clock::now();
+	par::parallel_for(count, workers, [&](uint32_t i)
+	{
+		std::string filename = seed_name(pattern, seed + i);
+		out::Output* surface =
+			new out::Output(backend, filename, width, height);
+		Workspace* draft = make_draft(surface, seed + i);
+		draft->setWorkers(1);
+		draft->setBatching(batching);
+		draft->runTempere(110,false);
+		draft->render();
+		save_picture(surface);
+		delete draft;
+		delete surface;
+	});
+	std::chrono::duration<double> took =
+		std::chrono::steady_clock::now() - start;
+	printf("Made %u pictures on %u workers in %fs, %f pictures/s\n",
+		count, workers, took.count(), count / took.count());
+}
+
 int main(int argc, char* argv[])
 {
-	std::string filename = "image.svg";
+	std::string filename = "";
+	out::BACKEND backend = out::BACKEND::SVG;
+	uint32_t width = 1920;
+	uint32_t height = 1080;
 	bool debug = false;
+	uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+	uint32_t count = 0;
+	uint32_t workers = 0;
+	bool batching = true;
+	// Layout steps, by default 110 or none after loading a layout
+	int steps = -1;
+	// With -g, snapshot every stride-th layout step
+	uint32_t stride = 1;
+	// Beam search keeps width branches forked on their fan best operators,
+	// off when zero
+	uint32_t beam = 0;
+	uint32_t fan = 0;
+	std::string load = "";
+	std::string save = "";
+	// PNGs can be drawn and streamed out this many rows at a time
+	uint32_t band = 0;
 	int arg = 0;
-	while((arg = getopt(argc, argv, "gf:")) != -1)
+	while((arg = getopt(argc, argv, "gBb:f:j:k:l:m:n:o:r:s:t:w:")) != -1)
 	{
 		switch(arg)
 		{
+			case 'b':
+				if(sscanf(optarg, "%ux%u", &beam, &fan) != 2)
+				{
+					printf("Beam must be WIDTHxFAN\n");
+					return 1;
+				}
+				break;
+			case 'k':
+				stride = atoi(optarg);
+				break;
+			case 'l':
+				load = optarg;
+				break;
+			case 'm':
+				band = atoi(optarg);
+				break;
+			case 't':
+				steps = atoi(optarg);
+				break;
+			case 'w':
+				save = optarg;
+				break;
 			case 'f':
 				filename = optarg;
 				break;
 			case 'g':
 				debug = true;
 				break;
+			case 'j':
+				workers = atoi(optarg);
+				break;
+			case 'n':
+				count = atoi(optarg);
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'B':
+				batching = false;
+				break;
+			case 'o':
+				if(!out::backend(optarg, backend))
+				{
+					printf("Unknown output %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 'r':
+				if(sscanf(optarg, "%ux%u", &width, &height) != 2)
+				{
+					printf("Resolution must be WIDTHxHEIGHT\n");
+					return 1;
+				}
+				break;
 			default:
 				continue;
 		}
 	}
-	test_render(filename,debug);
+	// With a count, seeds seed to seed + count - 1 are made in one process
+	if(count > 0)
+	{
+		if(filename == "") { filename = "image_%llu." + out::name(backend); }
+		if(!seed_pattern(filename))
+		{
+			printf("Batch filename must hold %s once for the seed\n",
+				SEED.c_str());
+			return 1;
+		}
+		test_batch(filename,backend,width,height,seed,count,workers,batching);
+		return 0;
+	}
+	if(filename == "") { filename = "image." + out::name(backend); }
+	out::Output* surface = NULL;
+	if(band > 0 && backend == out::BACKEND::PNG)
+	{
+		surface = new out::Output(filename, width, height, band);
+	}
+	else { surface = new out::Output(backend, filename, width, height); }
+	test_render(surface,seed,debug,workers,batching,stride,beam,fan,steps,load,save);
+	delete surface;
 	return 0;
 }
 #endif
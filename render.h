@@ -7,6 +7,20 @@
 // Geometry definition(s)
 #include "geom.h"
 using namespace geom;
+// Draw command buffer
+#include "record.h"
+// Output backends
+#include "output.h"
+// Random streams
+#include "random.h"
+// Saved layouts
+#include "checkpoint.h"
+// Copy-on-write storage
+#include "cow.h"
+// Adjacency graphs
+#include "graph.h"
+// Running statistics
+#include "aggregate.h"
 
 // (Limited C++ imports) GIB STRING CLASS GCC!
 #include <string>
@@ -15,6 +29,8 @@ using namespace geom;
 #include <map>
 #include <functional>
 #include <set>
+#include <unordered_map>
+#include <initializer_list>
 
 #ifndef render_h
 #define render_h
@@ -25,16 +41,67 @@ using namespace geom;
 // Class definitions
 class Layer;
 class Workspace;
+// Constraint names are interned into small keys the first time they are seen,
+// so looking one up on a segment indexes a slot instead of comparing strings.
+namespace cst
+{
+	// The names the factories make are interned first, in this order
+	enum KEY : uint32_t
+	{
+		SIZE,
+		COMPLEXITY,
+		ORIENTATION,
+		PERTURBATION,
+		LIGHTING,
+		PALETTE
+	};
+	uint32_t key(const std::string&);
+	const std::string& name(uint32_t key);
+	// The keys of a set of names, interned once where an operator or brush
+	// is made. They keep the order of the names, so uses run as before.
+	class Keys
+	{
+		std::vector<uint32_t> key;
+		public:
+			Keys() {};
+			Keys(std::initializer_list<std::string> names);
+			std::vector<uint32_t>::const_iterator begin() const
+			{
+				return key.begin();
+			}
+			std::vector<uint32_t>::const_iterator end() const
+			{
+				return key.end();
+			}
+			uint32_t size() const { return key.size(); }
+	};
+};
 // Constraints are discrete or continuous, which are represented by a
-// boolean mask or float, respectively.
+// boolean mask or float, respectively. The name is kept as its key.
 typedef struct constraint
 {
-	std::string name;
+	uint32_t key;
 	uint32_t type;
 	uint32_t mask;
 	double dial;
 } Constraint;
 
+namespace cst
+{
+	// Constraints sorted by key, those of key k are con[slot[k]] up to
+	// con[slot[k+1]]. Tables are shared, never written after being built.
+	typedef struct table
+	{
+		std::vector<Constraint> con;
+		std::vector<uint32_t> slot;
+		// How many constraints of each key have a dial, counted when built
+		std::vector<uint32_t> dials;
+	} Table;
+	Table table(std::vector<Constraint>);
+	// The constraints of a table with those of over in place of their keys
+	Table merge(const Table&, const std::vector<Constraint>& over);
+};
+
 /*
 inline bool operator ==(const Constraint &a, const Constraint &b)
 {
@@ -63,6 +130,14 @@ namespace std
 }*/
 
 
+// How well a brush or operator fits, found before doing any of its work
+typedef struct score
+{
+	bool usable;
+	double match;
+	double priority;
+} Score;
+
 // A valued callback!
 typedef struct callback
 {
@@ -78,8 +153,10 @@ typedef struct op
 {
 	std::string name;
 	// The constraints it uses for different types
-	std::set<std::string> cons;
-	std::function<Callback(Workspace*,struct op)> layout;
+	cst::Keys cons;
+	// Scored every layout step, only the chosen operator lays out
+	std::function<Score(Workspace*,const struct op&)> score;
+	std::function<void(Workspace*,const struct op&)> layout;
 } Operator;
 
 inline bool operator ==(const Operator &a, const Operator &b)
@@ -117,9 +194,13 @@ typedef struct brush
 	// The prescidence of the brush
 	double priority;
 	// The constraints it uses
-	std::set<std::string> cons;
-	// The actual drawing function
-	std::function<Callback(Workspace*, struct segment, struct brush)> draw;
+	cst::Keys cons;
+	// Scored for every segment, only chosen brushes prepare a drawing
+	std::function<Score(Workspace*, const struct segment&, const struct brush&)>
+		score;
+	// The actual drawing function, recorded when it is called
+	std::function<std::function<void()>(
+		Workspace*, const struct segment&, const struct brush&)> draw;
 } Brush;
 
 inline bool operator ==(const Brush &a, const Brush &b)
@@ -148,51 +229,64 @@ namespace std
 }
 
 
-// A segment holds constraints and has a pointer to a canvas where it can paint
+// A segment holds constraints and has a pointer to a record where it can paint
 // As it must be copiable by value, it uses lambdas to create snapshots.
 // TODO: move relationships and caches into here using lambdas?
 typedef struct segment
 {
 	// ID of this segment
 	uint32_t sid;
-	// The canvas may be shared between segments
-	cairo_surface_t* canvas;
+	// An id that lasts as long as the segment is not split, unlike sid
+	uint64_t uid;
+	// The record may be shared between segments
+	rec::Buffer* record;
 	// Scale of coordinates -> pixels
 	double scale;
 	// Layer segment is on.
 	uint32_t layer;
 	// The boundary of the segment
 	std::vector<Vertex> boundary;
-	// The constraints imposed on the segment from all sources
-	std::vector<Constraint> constraint;
+	// The constraints set on the segment itself, and the defaults of its layer
+	// for the keys it does not set. Both are shared tables, so a segment is
+	// the same size however many constraints there are.
+	cow::Cow<cst::Table> own;
+	cow::Cow<cst::Table> base;
 	// Constructors for empty and null stuff
 	segment& operator=(const segment&) & = default;
 	segment() :
 		sid{0},
-		canvas{NULL},
+		uid{0},
+		record{NULL},
 		scale{0.0},
 		layer{0},
 		boundary{{}},
-		constraint{{}} {};
+		own{},
+		base{} {};
 	segment(const segment& s) : 
 		sid{s.sid},
-		canvas{s.canvas},
+		uid{s.uid},
+		record{s.record},
 		scale{s.scale},
 		layer{s.layer},
 		boundary{s.boundary},
-		constraint{s.constraint} {};
+		own{s.own},
+		base{s.base} {};
 	segment(uint32_t sid,
-		cairo_surface_t* canvas,
+		uint64_t uid,
+		rec::Buffer* record,
 		double scale,
 		uint32_t layer,
 		std::vector<Vertex> bound,
-		std::vector<Constraint> con) : 
+		cow::Cow<cst::Table> own,
+		cow::Cow<cst::Table> base) : 
 		sid{sid},
-		canvas{canvas},
+		uid{uid},
+		record{record},
 		scale{scale},
 		layer{layer},
 		boundary(bound),
-		constraint(con) {};
+		own{own},
+		base{base} {};
 } Segment;
 
 inline bool operator ==(const Segment &a, const Segment &b)
@@ -221,6 +315,28 @@ namespace std
 	};
 }
 
+// Logical links indexed both ways in segment ids, the members of each link
+// and the links of each segment, with the groups the links join
+typedef struct linkindex
+{
+	std::vector<std::vector<uint32_t>> member;
+	std::vector<std::vector<uint32_t>> link;
+	graph::Groups group;
+} LinkIndex;
+
+// A change to a segment by uid, as kept in the workspace journal
+typedef struct change
+{
+	enum KIND : uint32_t
+	{
+		ADDED,
+		REMOVED,
+		SET
+	};
+	KIND kind;
+	uint64_t uid;
+} Change;
+
 // A layer holds a set of vertexes, ordered into segments and with
 // logical relationships that require a class construction
 // it also holds global and local constraints
@@ -232,34 +348,54 @@ class Layer
 	{
 		uint32_t sid;
 		std::vector<uint32_t> vid;
+		// Kept by a shard until it is split
+		uint64_t uid;
 	};
-	std::vector<segment> shard;
-	std::vector<Vertex> vertex;
-	// Map: global -> local. Rev: local -> global.
-	std::map<uint32_t,uint32_t> segMap;
-	std::map<uint32_t,uint32_t> segRev;
-	// Geometry relationships (purely local)
-	std::map<uint32_t,std::set<uint32_t>> geomRel;
-	std::map<uint32_t,std::vector<Constraint>> constraint;
+	// The uid of the next new shard
+	uint64_t serial = 0;
+	// All storage is copy-on-write, so copying a layer is O(1) and each
+	// copy only duplicates the parts it changes.
+	cow::Cow<std::vector<segment>> shard;
+	cow::Chunks<Vertex> vertex;
+	// Map: local -> global. Rev: global -> local.
+	cow::Cow<std::map<uint32_t,uint32_t>> segMap;
+	cow::Cow<std::map<uint32_t,uint32_t>> segRev;
+	// Shards sharing an edge (purely local), patched as shards split
+	cow::Cow<graph::CSR> adjacency;
+	// Constraints set on single shards, children share their parent's
+	cow::Cow<std::map<uint32_t,cow::Cow<cst::Table>>> constraint;
+	// Constraints every shard inherits unless it sets the key itself
+	cow::Cow<cst::Table> defaults;
 	// Add a segment (purely local)
-	uint32_t addsegment(std::vector<segment>&,Polygon);
+	uint32_t addsegment(std::vector<segment>&,Polygon,uint64_t uid);
 	uint32_t ensureVid(Vertex);
+	uint32_t local(uint32_t sid);
 	// Logical relationships (semi-local, sid is local lid is global)
-	std::map<uint32_t,std::set<uint32_t>> logicRel;
+	cow::Cow<std::map<uint32_t,std::set<uint32_t>>> logicRel;
 	// A single cache response
 	Segment cache(Workspace*, uint32_t gid, uint32_t sid, uint32_t height);
 	// All public functions return workspace-specific ids. (global)
 	public:
 		// Initialization
 		Layer(std::vector<Vertex>);
-		void tempere(std::vector<Vertex> boundary);
+		// Cut the shards by a boundary, noting the shards split and made
+		void tempere(std::vector<Vertex> boundary, std::vector<Change>&);
+		// Segment uids are unique across layers by their height
+		static uint64_t uid(uint32_t height, uint64_t shard)
+		{
+			return ((uint64_t)height << 40) | shard;
+		}
 		// Data access
-		std::set<uint32_t> geom(Segment);
-		std::set<uint32_t> logic(uint32_t);
+		// Shards sharing an edge with a local shard, offset to global ids
+		graph::Range neighbours(uint32_t local, uint32_t base);
+		// Logical links by link id, in local ids
+		const std::map<uint32_t,std::set<uint32_t>>& logic();
 		// Segments perform blocking and unification between workspaces
 		void updateConstraint(Segment, std::vector<Constraint>);
-		// Link a segment to a link id
-		void linkLogical(Segment, uint32_t lid);
+		// Add a constraint every shard inherits
+		void inherit(Constraint);
+		// Link a local shard to a link id
+		void linkLogical(uint32_t local, uint32_t lid);
 		// Get all uncached segments
 		std::vector<Segment> unmappedSegment(
 			Workspace*,
@@ -270,6 +406,9 @@ class Layer
 			Workspace* ws,
 			uint32_t height,
 			std::function<uint32_t()> gidgen);
+		// Checkpoints, constraint names are interned in the string table
+		void save(ckpt::Writer&, ckpt::Strings&);
+		bool load(ckpt::Reader&, const std::vector<std::string>&);
 };
 
 // A workspace holds layers and cairo drawing context.
@@ -277,33 +416,46 @@ class Workspace
 {
 	// Scale and canvas are private, read-only
 	double const_scale;
-	cairo_surface_t* const_canvas;
+	out::Output* const_canvas;
+	// Size of the boundary in pixels at scale, the canvas may be zoomed
+	Vertex const_size;
+	// The draw commands of the last render, played back onto the canvas
+	rec::Buffer const_record;
 	/* Persistant data, remains intact after layout or draw */
+	// These are shared with forks until either side changes them
 	// The constraints which direct brushes
-	std::vector<Constraint> constraint;
+	cow::Cow<std::vector<Constraint>> constraint;
 	// The operators which can modify segments and impose constraints
-	std::vector<Operator> oper;
+	cow::Cow<std::vector<Operator>> oper;
 	// The brushes that consume constraints to produce art!
-	std::vector<Brush> brush;
+	cow::Cow<std::vector<Brush>> brush;
 	// There is always a background layer
 	Layer* background;
 	// A list of layers sorted by height. Min is zero.
 	std::vector<uint32_t> height;
 	std::map<uint32_t,Layer*> layer;
 	// A set of all logical relationships in the workspace
-	std::vector<uint32_t> logic;
+	cow::Cow<std::vector<uint32_t>> logic;
 	// Static caches for dependency injection TODO: actually implement
 	std::map<Operator,std::map<uint32_t,uint32_t>> op_internal;
 	std::map<Brush,std::map<uint32_t,uint32_t>> br_internal;
 	/* Volatile data, regenerated after layout or draw */
 	uint32_t registerSegmentID = 0;
-	std::vector<Segment> segment;
+	// Shared with forks until either side regenerates it
+	cow::Cow<std::vector<Segment>> segment;
 	std::function<uint32_t()> sidGen()
 	{
-		uint32_t monoid = segment.size();
+		uint32_t monoid = segment->size();
 		return [=]() mutable -> uint32_t { return monoid++; };
 	};
-	std::map<uint32_t,std::set<uint32_t>> linkMap;
+	cow::Cow<LinkIndex> linkIndex;
+	// The id of the first segment on each layer, segment ids run in order
+	std::map<uint32_t,uint32_t> layerBase;
+	cow::Cow<graph::CSR> cutGraph;
+	// Segment ids by uid
+	cow::Cow<std::unordered_map<uint64_t,uint32_t>> uidIndex;
+	// Every segment change in order, read by operators keeping statistics
+	cow::Chunks<Change> journal;
 	/* Private functions */
 	// The next layer on which boundary fits without envelopment
 	Layer* addLayer(uint32_t height, std::vector<Vertex> boundary);
@@ -311,30 +463,90 @@ class Workspace
 	// A single layout step
 	bool ensureReadyLayout();
 	double layoutStep(std::vector<double> zipfs);
+	// Every operator scored on the layout, weighted by zipfs
+	std::vector<Score> layoutScores(std::vector<double> zipfs);
+	// The usable operators with the best match, at most count of them
+	std::vector<uint32_t> layoutBest(std::vector<double> zipfs, uint32_t count);
+	// The highest operator match left on the layout. Matches are how much
+	// an operator still wants to act, so lower is further along.
+	double layoutScore(std::vector<double> zipfs);
 	// A single draw step
 	std::vector<Callback> drawSegment(Segment s, std::vector<double> zipf);
+	// Threads used to evaluate brushes during render
+	uint32_t workers;
+	// Whether draw commands are merged by paint before playing them
+	bool batching;
+	// Debug layouts snapshot every stride-th step
+	uint32_t stride;
 	// Function Utilities
 	bool ensureReadyRender();
+	bool playRecord();
+	// Play one record per layer, on workers for raster outputs
+	bool playLayers(const std::vector<rec::Buffer>&);
+	// Play a record by square tiles of the canvas on workers, raster only
+	static constexpr uint32_t TILE = 512;
+	bool playTiles(const rec::Buffer&);
+	// Play a record by bands of a banded canvas, streaming each one out
+	bool playBands(const rec::Buffer&);
+	// Play onto an image of h canvas rows from row y0 on, by tiles
+	uint32_t playRegion(
+		const rec::Buffer&,
+		const std::vector<rec::Box>& bounds,
+		cairo_surface_t*,
+		uint32_t y0,
+		uint32_t h);
+	bool raster();
+	uint32_t tiles();
 	// Public operations, called by the runtime directly or through DI
 	public:
 		// Initializer for the workspace
 		// Workspace();
-		Workspace(cairo_surface_t*,std::vector<Vertex>,double);
-		Workspace(const Workspace&,cairo_surface_t*);
+		Workspace(out::Output*,std::vector<Vertex>,double,uint64_t seed);
+		Workspace(const Workspace&,out::Output*);
+		// Layers belong to the workspace that made them
+		~Workspace();
 		// Find segments with a certain match, default all segments
 		std::vector<Segment> cut();
 		std::set<Segment> geomRel(Segment);
+		// Ids of the segments sharing an edge with one, read in place
+		graph::Range neighbours(const Segment&);
+		const Segment& cutAt(uint32_t sid) { return (*segment)[sid]; }
+		uint32_t cutSize() { return segment->size(); }
+		// Each layer is drawn as its own record, see playLayers
+		uint32_t layers() { return height.size(); }
+		// The same adjacency over the whole cut, for graph searches
+		const graph::CSR& adjacency() { return *cutGraph; }
+		// The segment with a uid, NULL if it was split or is not cached yet
+		const Segment* find(uint64_t uid);
+		const cow::Chunks<Change>& changes() { return journal; }
 		std::set<Segment> logicRel(Segment);
+		// Ids of the segments joined to one through any chain of links
+		std::vector<uint32_t> logicGroup(const Segment&);
 		// Store caches used by operators, volatile TODO: fix volatile
-		std::map<Operator,std::map<Segment,uint32_t>> op_cache;
+		// Marks of each operator are shared with forks until written
+		std::map<Operator,cow::Cow<std::map<Segment,uint32_t>>> op_cache;
 		std::map<Brush,std::map<Segment,uint32_t>> br_cache;
+		// Running statistics operators keep up with the journal, by name
+		std::map<std::string,cow::Cow<agg::Tally>> op_stats;
+		// Candidates operators keep ranked with the journal, by name
+		std::map<std::string,cow::Cow<agg::Ranking>> op_ranks;
 		// Main runtime functions
 		bool addBrush(Brush);
 		bool addOperator(Operator);
 		bool addConstraint(Constraint);
 		bool runTempere(uint32_t steps,bool);
+		// Beam search layout, forking every branch on its fan best scored
+		// operators and keeping the width forks with the least left to do
+		// at every step. Returns the best layout as a new workspace.
+		Workspace* runBeam(uint32_t steps, uint32_t width, uint32_t fan);
 		bool render();
 		bool renderDebug();
+		void setWorkers(uint32_t);
+		void setBatching(bool);
+		void setStride(uint32_t);
+		// Save or restore the layout and random stream, see checkpoint.h
+		bool saveLayout(std::string filename);
+		bool loadLayout(std::string filename);
 		// Operator specific public functions for segment manipulations
 		void setConstraint(Operator, Segment, std::vector<Constraint>);
 		// TODO: may need to add operator verification here
@@ -346,7 +558,12 @@ class Workspace
 		void linkSegment(Operator, Segment, Segment);
 		// Brush specific public data TODO: add brush verification?
 		double scale() { return const_scale; }
-		cairo_surface_t* canvas() { return const_canvas; };
-		std::function<double()> rand;
+		out::Output* canvas() { return const_canvas; };
+		rec::Buffer* record() { return &const_record; };
+		rng::Random rand;
 };
+
+// Runtime setup and output, see render.c
+void init_workspace(Workspace*);
+void save_picture(out::Output*);
 #endif
@@ -0,0 +1,77 @@
+// C imports
+#include <float.h>
+
+// C++ imports
+#include <vector>
+#include <algorithm>
+
+// Module imports
+#include "sampler.h"
+
+smp::Weighted::Weighted(
+	const std::vector<double>& weights, const std::vector<bool>& usable)
+{
+	weight = weights;
+	for(uint32_t i = 0; i < weight.size(); i++)
+	{
+		if(usable[i]) { order.push_back(i); }
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b) { return weight[a] > weight[b]; });
+	build(0);
+}
+
+void smp::Weighted::add(uint32_t i, double w)
+{
+	total += w;
+	for(i++; i <= tree.size(); i += i & -i) { tree[i-1] += w; }
+}
+
+void smp::Weighted::build(uint32_t count)
+{
+	// Linear build from the first count usable weights
+	tree.assign(weight.size(), 0.0);
+	total = 0.0;
+	for(uint32_t k = 0; k < count; k++)
+	{
+		tree[order[k]] = weight[order[k]];
+		total += weight[order[k]];
+	}
+	for(uint32_t i = 1; i <= tree.size(); i++)
+	{
+		uint32_t up = i + (i & -i);
+		if(up <= tree.size()) { tree[up-1] += tree[i-1]; }
+	}
+	eligible = count;
+}
+
+int64_t smp::Weighted::draw(double d, double r)
+{
+	// Usable weights above d are a prefix of the order
+	uint32_t count = eligible;
+	while(count < order.size() && weight[order[count]] > d) { count++; }
+	while(count > 0 && !(weight[order[count-1]] > d)) { count--; }
+	if(count < eligible) { build(count); }
+	for(; eligible < count; eligible++)
+	{
+		add(order[eligible], weight[order[eligible]]);
+	}
+	if(eligible == 0) { return -1; }
+	// The first index whose prefix sum reaches the pick. Skipped weights
+	// are zero, so a pick of zero must still land on an eligible one.
+	double pick = total * r;
+	if(pick <= 0.0) { pick = DBL_MIN; }
+	uint32_t at = 0;
+	uint32_t step = 1;
+	while(step * 2 <= tree.size()) { step *= 2; }
+	for(; step > 0; step /= 2)
+	{
+		if(at + step <= tree.size() && tree[at+step-1] < pick)
+		{
+			at += step;
+			pick -= tree[at-1];
+		}
+	}
+	if(at >= weight.size()) { return -1; }
+	return at;
+}
@@ -0,0 +1,32 @@
+// C++ imports
+#include <vector>
+#include <cstdint>
+
+#ifndef sampler_h
+#define sampler_h
+namespace smp
+{
+	// Draws indices in proportion to their weights, among the usable ones
+	// weighing more than a threshold. Weights are kept in a Fenwick tree in
+	// their original order, so a draw is O(log n) and lowering the threshold
+	// only adds the newly eligible weights.
+	class Weighted
+	{
+		// Weights in the original order and the usable ones by weight
+		std::vector<double> weight;
+		std::vector<uint32_t> order;
+		// Prefix sums over the eligible weights, and how many are in it
+		std::vector<double> tree;
+		uint32_t eligible;
+		double total;
+		void add(uint32_t i, double w);
+		void build(uint32_t count);
+		public:
+			Weighted(const std::vector<double>& weights,
+				const std::vector<bool>& usable);
+			// The index drawn by r in [0,1) among the weights above d, or
+			// -1 when none are above d.
+			int64_t draw(double d, double r);
+	};
+};
+#endif
@@ -23,7 +23,9 @@ struct dials
 };
 
 
-void draw_circle(cairo_t* drawer, double area, Vertex mid, struct dials d)
+void draw_circle(
+	rec::Buffer* record, rec::Source src,
+	double area, Vertex mid, struct dials d)
 {
 	// Constraint satisfaction
 	double len = sqrt(area) / 2.0;
@@ -31,53 +33,52 @@ void draw_circle(cairo_t* drawer, double area, Vertex mid, struct dials d)
 	scale = len * 0.5;
 	// Draw
 	// Translate along the orientation axis and scale a bit!
-	cairo_translate(drawer, mid.x, mid.y);
-	cairo_rotate(drawer, 2.0 * M_PI * d.ori);
-	cairo_scale(drawer, 0.7, 1);
-	cairo_arc(drawer, 0.0, 0.0, scale, 0.0, 2.0 * M_PI);
-	cairo_fill(drawer);
+	record->transform(mid, 2.0 * M_PI * d.ori, 0.7, 1.0);
+	record->arc({0.0, 0.0}, scale, 0.0, 2.0 * M_PI, src);
+	record->identity();
 }
 
-void draw_ngon(cairo_t* drawer, int N, double area, Vertex mid, struct dials d)
+void draw_ngon(
+	rec::Buffer* record, rec::Source src,
+	int N, double area, Vertex mid, struct dials d)
 {
 	// Constraint satisfaction
 	double len = sqrt(area) / 2.0;
 	double scale = (len / 2.0) + ((len / 2.0) * d.siz);
 	// Utility variables
 	double delta = 2.0 * M_PI / N;
-	bool init = false;
 	// Scale to orientation
-	cairo_translate(drawer, mid.x, mid.y);
-	cairo_rotate(drawer, 2.0 * M_PI * d.ori);
-	cairo_scale(drawer, 0.7, 1);
+	record->transform(mid, 2.0 * M_PI * d.ori, 0.7, 1.0);
+	Polygon ngon;
 	for(int n = 0; n < N; n++)
 	{
 		double x_rel = sin(delta * n) * scale;
 		double y_rel = cos(delta * n) * scale;
-		Vertex v = {x_rel, y_rel};
-		if(!init) { cairo_move_to(drawer, v.x, v.y); init = true; }
-		else { cairo_line_to(drawer, v.x, v.y); }
+		ngon.push_back({x_rel, y_rel});
 	}
-	cairo_fill(drawer);
+	record->fill(ngon, src);
+	record->identity();
 }
 
-void shapelambda(Segment s, Color col, int N, struct dials d)
+void shapelambda(
+	rec::Buffer* record, double area, Vertex mid, Color col, int N, struct dials d)
 {
-	// Create a shape in the center of the segment scaled to the area
-	double area = abs(signed_area(s.boundary)) * s.scale * s.scale;
-	Vertex mid = scale(centroid(s.boundary),s.scale);
-	// Create a canvas to draw on!
-	cairo_t* drawer = cairo_create(s.canvas);
-	cairo_set_source_rgba(drawer, col.red, col.green, col.blue, 1.0);
-	//cairo_set_source_rgba(drawer, col.red, col.green, col.blue, 0.1);
+	rec::Source src = color_source(col, 1.0);
 	// Draw a circle if complexity is too low!
-	if(N < 3) { draw_circle(drawer, area, mid, d); }
+	if(N < 3) { draw_circle(record, src, area, mid, d); }
 	// Draw a regular N-gon if complexity is high!
-	else { draw_ngon(drawer, N, area, mid, d); }
-	cairo_destroy(drawer);
+	else { draw_ngon(record, src, N, area, mid, d); }
+}
+
+Score shape_score(Workspace*, const Segment&, const Brush& b)
+{
+	// Decide if this brush is a good match
+	bool usable = true;
+	double match = 1.0; // TODO: smarter!
+	return {usable, match, b.priority};
 }
 
-Callback shape(Workspace* ws, Segment s, Brush b)
+std::function<void()> shape(Workspace* ws, const Segment& s, const Brush&)
 {
 	// TODO: use orientation and entropy to modify stuff!
 	// Check size, complexity, and palette constraints
@@ -86,38 +87,28 @@ Callback shape(Workspace* ws, Segment s, Brush b)
 	//double com_dial = -1.0;
 	//double siz_dial = -1.0;
 	//double ori_dial = -1.0;
-	auto com_match = match_constraint("complexity", s.constraint);
-	auto siz_match = match_constraint("size", s.constraint);
-	auto ori_match = match_constraint("orientation", s.constraint);
-	auto pal_match = match_constraint("palette", s.constraint);
-	d.com = distribution(com_match)(ws->rand);
-	d.siz = distribution(siz_match)(ws->rand);
-	d.ori = distribution(ori_match)(ws->rand);
+	auto pal_match = match_constraint(s, cst::PALETTE);
+	d.com = draw(s, cst::COMPLEXITY, ws->rand);
+	d.siz = draw(s, cst::SIZE, ws->rand);
+	d.ori = draw(s, cst::ORIENTATION, ws->rand);
 	for(auto p : pal_match) { palette_mask |= p.mask; }
 	
 	// Choose a palette and color!
 	Palette pal = pick_palette(ws, palette_mask);
-	Color col = pick_color(ws, &pal, s.constraint);
+	Color col = pick_color(ws, &pal);
 
 	// Decide what shape depending on complexity!
 	// Make a linear map between com and N = 10
 	double maxN = 10.0;
 	int N = int(d.com * maxN);
 
-	// Decide if this brush is a good match
-	bool usable = true;
-	double match = 1.0; // TODO: smarter!
-
-	Callback ret
+	// Create a shape in the center of the segment scaled to the area
+	double area = abs(signed_area(s.boundary)) * s.scale * s.scale;
+	Vertex mid = scale(centroid(s.boundary),s.scale);
+	rec::Buffer* record = s.record;
+	return [=]() -> void
 	{
-		.usable = usable,
-		.match = match,
-		.priority = b.priority,
-		.callback = [=]() mutable -> void
-		{
-			//printf("Drawing Shape...\n");
-			shapelambda(s, col, N, d);
-		}
+		//printf("Drawing Shape...\n");
+		shapelambda(record, area, mid, col, N, d);
 	};
-	return ret;
 }
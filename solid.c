@@ -5,8 +5,6 @@
 #include <vector>
 
 // module imports
-#include <cairo.h>
-#include <cairo-svg.h>
 #include "palette.h"
 #include "render.h"
 #include "brushes.h"
@@ -14,51 +12,35 @@
 
 // Some brushes!
 
-void solidlambda(Segment s, Color color)
+void solidlambda(rec::Buffer* record, Polygon bound, Color color)
 {
-	// Create the drawing context
-	cairo_t* drawer = cairo_create(s.canvas);
-	// Line width
-	cairo_set_line_width(drawer, 10.0);
-	// Color
-	cairo_set_source_rgba(drawer, color.red, color.green, color.blue, 1);
-	//cairo_set_source_rgba(drawer, color.red, color.green, color.blue, .1);
-	// Draw along the vertexes
-	Vertex anchor = scale(s.boundary[0], s.scale);
-	cairo_move_to(drawer, anchor.x, anchor.y);
-	Vertex vert; 
-	for(auto v : s.boundary)
-	{
-		vert = scale(v, s.scale);
-		cairo_line_to(drawer, vert.x, vert.y);
-	}
-	cairo_close_path(drawer);
-	cairo_fill(drawer);
-	cairo_destroy(drawer);
+	record->fill(bound, color_source(color, 1.0));
+}
+
+Score solid_score(Workspace*, const Segment&, const Brush& b)
+{
+	// Solid is not chosen by match, it is drawn on the background directly
+	return {true, -1.0, b.priority};
 }
 
-Callback solid(Workspace* ws, Segment s, Brush b)
+std::function<void()> solid(Workspace* ws, const Segment& s, const Brush&)
 {
-	// Find color pallette and decide if complexity is high enough
+	// Find color pallette
 	// TODO: do something with generators to make this work...
-	double match = -1.0;
 	uint32_t palette_mask = 0;
-	auto palette_list = match_constraint("palette", s.constraint);
+	auto palette_list = match_constraint(s, cst::PALETTE);
 	for(auto m : palette_list) { palette_mask |= m.mask; }
 
 	Palette palette = pick_palette(ws, palette_mask);
-	Color color = pick_color(ws, &palette, s.constraint);
+	Color color = pick_color(ws, &palette);
 
-	Callback ret
+	// Fill along the vertexes, scaled to pixels
+	Polygon bound;
+	for(auto v : s.boundary) { bound.push_back(scale(v, s.scale)); }
+	rec::Buffer* record = s.record;
+	return [=]() -> void
 	{
-		.usable = true,
-		.match = match,
-		.priority = b.priority,
-		.callback = [=]() mutable -> void
-		{
-			//printf("Drawing Solid...\n");
-			solidlambda(s, color);
-		}
+		//printf("Drawing Solid...\n");
+		solidlambda(record, bound, color);
 	};
-	return ret;
 }
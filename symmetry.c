@@ -17,30 +17,54 @@
 int decide_symmetry(Workspace* ws, Segment s, Operator op)
 {
 	// Decide upon a symmetry
-	auto cmpmatch = match_constraint("complexity", s.constraint);
-	double sym = distribution(cmpmatch)(ws->rand);
+	double sym = draw(s, cst::COMPLEXITY, ws->rand);
 	return int(sym * 8);
 }
 
-std::vector<Segment> cut_mark_symmetry(Workspace* ws, Operator op)
+bool marked_symmetry(Workspace* ws, const Segment& s, const Operator& op)
 {
-	std::vector<Segment> ret;
-	for(auto s : ws->cut())
+	auto marks = ws->op_cache.find(op);
+	if(marks == ws->op_cache.end()) { return false; }
+	auto mark = marks->second->find(s);
+	return mark != marks->second->end() && mark->second == 1;
+}
+
+// Rank a segment by its area if it is unmarked and complex enough, keeping
+// the symmetry drawn for it
+void rank_symmetry(
+	Workspace* ws, agg::Ranking& r, const Segment& s, const Operator& op)
+{
+	r.erase(s.uid);
+	if(marked_symmetry(ws, s, op)) { return; }
+	int N = decide_symmetry(ws, s, op);
+	if(N < 2) { return; }
+	r.set(s.uid, geom::area(s.boundary), N);
+}
+
+// Bring the candidates up to date with the segments changed since they were
+// last read, so only those are decided and measured again
+agg::Ranking& cut_mark_symmetry(Workspace* ws, const Operator& op)
+{
+	agg::Ranking& r = ws->op_ranks[op.name].edit();
+	const cow::Chunks<Change>& log = ws->changes();
+	if(!r.primed)
 	{
-		// Check if segment is marked
-		uint32_t mark = ws->op_cache[op][s];
-		if(mark == 1) { continue; }
-		// Check if segment is complex enough
-		if(decide_symmetry(ws, s, op) < 2) { continue; }
-		ret.push_back(s);
+		for(uint32_t i = 0; i < ws->cutSize(); i++)
+		{
+			rank_symmetry(ws, r, ws->cutAt(i), op);
+		}
+		r.cursor = log.size();
+		r.primed = true;
+		return r;
 	}
-	// Sort by maximum area
-	auto arealamb = [](const Segment &s1,const Segment &s2) -> bool
+	for(; r.cursor < log.size(); r.cursor++)
 	{
-		return geom::area(s1.boundary) > geom::area(s2.boundary);
-	};
-	std::sort(ret.begin(),ret.end(),arealamb);
-	return ret;
+		Change c = log[r.cursor];
+		const Segment* s = ws->find(c.uid);
+		if(c.kind == Change::REMOVED || s == NULL) { r.erase(c.uid); continue; }
+		rank_symmetry(ws, r, *s, op);
+	}
+	return r;
 }
 
 std::vector<Edge> radial_segments(Segment max_seg, Vertex mid, int N)
@@ -88,37 +112,27 @@ void symmetrylambda(Workspace* ws, Operator op, Segment max_seg, int N)
 	// Make complexity constraints?
 }
 
-Callback symmetry(Workspace* ws, Operator op)
+Score symmetry_score(Workspace* ws, const Operator& op)
 {
-	// Find the usable segment with maximum perimeter
-	std::vector<Segment> segCand = cut_mark_symmetry(ws, op);
-	bool usable = false;
-	Segment max_seg;
-	if(segCand.size() > 0)
-	{
-		max_seg = segCand[0];
-		usable = true;
-	}
-	// Parameters for the callback
-	//bool usable = N < 2 ? false : true; // Cannot break into <2 pieces
+	// Usable if any segment could take a symmetry
+	bool usable = cut_mark_symmetry(ws, op).top() != NULL;
 	// TODO: make this smarter
-	double match = (1.0 / log(1.0 + ws->cut().size()));
-
-	// The callback!
-	Callback ret
-	{
-		.usable = usable,
-		.match = match,
-		.priority = 1.0,
-		.callback = [=]() mutable -> void
-		{
-			// If we proceed, mark this segment as used
-			// ws->op_cache[op][*max_seg] = 1;
-			int N = decide_symmetry(ws, max_seg, op);
-			printf("\nSYMMETRY (%d)...\n",N);
-			symmetrylambda(ws, op, max_seg, N);
-		}
-	};
+	double match = (1.0 / log(1.0 + ws->cutSize()));
+	return {usable, match, 1.0};
+}
 
-	return ret;
+void symmetry(Workspace* ws, const Operator& op)
+{
+	// Find the usable segment with maximum area
+	agg::Ranking& r = cut_mark_symmetry(ws, op);
+	const agg::Ranked* top = r.top();
+	if(top == NULL) { return; }
+	const Segment* found = ws->find(top->uid);
+	if(found == NULL) { r.erase(top->uid); return; }
+	// Adding segments moves the cut, so work from a copy
+	Segment max_seg = *found;
+	int N = top->value;
+	// If we proceed, this segment is used until it changes again
+	r.erase(max_seg.uid);
+	symmetrylambda(ws, op, max_seg, N);
 }
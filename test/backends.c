@@ -0,0 +1,77 @@
+// C imports
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+#include <chrono>
+
+// Module imports
+#include "../render.h"
+#include "../record.h"
+#include "../output.h"
+
+// Play the same record onto every backend and time it, file writing included
+double bench(rec::Buffer* record, out::BACKEND b, uint32_t w, uint32_t h, int runs)
+{
+	std::string filename = "bench." + out::name(b);
+	double zoom = w / 1920.0;
+	rec::Buffer sorted = record->batched(64);
+	auto start = std::chrono::steady_clock::now();
+	for(int r = 0; r < runs; r++)
+	{
+		out::Output* canvas = new out::Output(b, filename, w, h);
+		rec::play(sorted, canvas->surface(), true, zoom);
+		canvas->finish();
+		if(b == out::BACKEND::RGBA) { canvas->rgba(); }
+		delete canvas;
+	}
+	std::chrono::duration<double> took =
+		std::chrono::steady_clock::now() - start;
+	return took.count();
+}
+
+int main(int argc, char* argv[])
+{
+	int runs = argc > 1 ? atoi(argv[1]) : 20;
+	uint32_t w = argc > 2 ? atoi(argv[2]) : 1920;
+	uint32_t h = argc > 3 ? atoi(argv[3]) : 1080;
+	// Lay out and render a single picture to get a record
+	std::vector<Vertex> boundary = {
+		{0.0,0.0},
+		{16.0,0.0},
+		{16.0,9.0},
+		{0.0,9.0}};
+	out::Output* canvas = new out::Output(out::BACKEND::RGBA, "", 1920, 1080);
+	Workspace* ws = new Workspace(canvas, boundary, 120.0, 1);
+	init_workspace(ws);
+	ws->runTempere(110, false);
+	ws->render();
+	printf("\nBACKEND BENCHMARK: %zu commands, %d runs at %ux%u\n",
+		ws->record()->size(), runs, w, h);
+	std::vector<out::BACKEND> backends =
+	{
+		out::BACKEND::SVG,
+		out::BACKEND::PDF,
+		out::BACKEND::PNG,
+		out::BACKEND::RGBA
+	};
+	for(auto b : backends)
+	{
+		double took = bench(ws->record(), b, w, h, runs);
+		struct stat info;
+		std::string filename = "bench." + out::name(b);
+		long long bytes = 0;
+		if(b != out::BACKEND::RGBA && stat(filename.c_str(), &info) == 0)
+		{
+			bytes = info.st_size;
+			remove(filename.c_str());
+		}
+		printf("%-5s %10.4fs %10.2f images/s %12lld bytes\n",
+			out::name(b).c_str(), took, runs / took, bytes);
+	}
+	delete canvas;
+	return 0;
+}
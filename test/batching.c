@@ -0,0 +1,112 @@
+// C imports
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+#include <chrono>
+
+// Module imports
+#include "../render.h"
+#include "../record.h"
+#include "../output.h"
+
+typedef struct result
+{
+	uint32_t paths;
+	long long elements;
+	long long bytes;
+	double seconds;
+} Result;
+
+// Count the drawn elements of an SVG, each path cairo writes is one
+long long svg_elements(std::string filename)
+{
+	FILE* f = fopen(filename.c_str(), "r");
+	if(f == NULL) { return -1; }
+	long long count = 0;
+	char line[4096];
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		char* at = strstr(line, "<path");
+		for(; at != NULL; at = strstr(at + 1, "<path")) { count++; }
+	}
+	fclose(f);
+	return count;
+}
+
+// Play a record onto a backend, as drawn or merged by paint, with the
+// batching itself counted in the time
+Result bench(rec::Buffer* record, out::BACKEND b, bool batch, int runs)
+{
+	std::string filename = "batching." + out::name(b);
+	double zoom = 1.0;
+	Result ret {0, -1, 0, 0.0};
+	auto start = std::chrono::steady_clock::now();
+	for(int r = 0; r < runs; r++)
+	{
+		out::Output* canvas = new out::Output(b, filename, 1920, 1080);
+		if(batch)
+		{
+			rec::Buffer sorted = record->batched(64);
+			ret.paths = rec::play(sorted, canvas->surface(), true, zoom);
+		}
+		else { ret.paths = rec::play(*record, canvas->surface(), false, zoom); }
+		canvas->finish();
+		delete canvas;
+	}
+	std::chrono::duration<double> took =
+		std::chrono::steady_clock::now() - start;
+	ret.seconds = took.count() / runs;
+	struct stat info;
+	if(stat(filename.c_str(), &info) == 0) { ret.bytes = info.st_size; }
+	if(b == out::BACKEND::SVG) { ret.elements = svg_elements(filename); }
+	remove(filename.c_str());
+	return ret;
+}
+
+int main(int argc, char* argv[])
+{
+	int runs = argc > 1 ? atoi(argv[1]) : 10;
+	// Seed 3 draws from a fixed palette, random palettes rarely share paint
+	uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 3;
+	// Lay out and render a single picture to get a record
+	std::vector<Vertex> boundary = {
+		{0.0,0.0},
+		{16.0,0.0},
+		{16.0,9.0},
+		{0.0,9.0}};
+	out::Output* canvas = new out::Output(out::BACKEND::RGBA, "", 1920, 1080);
+	Workspace* ws = new Workspace(canvas, boundary, 120.0, seed);
+	init_workspace(ws);
+	ws->runTempere(110, false);
+	ws->render();
+	printf("\nBATCHING BENCHMARK: %zu commands, seed %llu, %d runs\n",
+		ws->record()->size(), (unsigned long long)seed, runs);
+	printf("%-5s %-7s %8s %10s %12s %10s\n",
+		"", "", "paths", "elements", "bytes", "seconds");
+	std::vector<out::BACKEND> backends =
+	{
+		out::BACKEND::SVG,
+		out::BACKEND::PDF,
+		out::BACKEND::PNG
+	};
+	for(auto b : backends)
+	{
+		for(bool batch : {false, true})
+		{
+			Result r = bench(ws->record(), b, batch, runs);
+			std::string elements =
+				r.elements < 0 ? "-" : std::to_string(r.elements);
+			printf("%-5s %-7s %8u %10s %12lld %10.5f\n",
+				out::name(b).c_str(), batch ? "batched" : "drawn",
+				r.paths, elements.c_str(), r.bytes, r.seconds);
+		}
+	}
+	delete ws;
+	delete canvas;
+	return 0;
+}
@@ -0,0 +1,160 @@
+// C imports
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+
+// Module imports
+#include "../render.h"
+#include "../output.h"
+#include "../operators.h"
+#include "../checkpoint.h"
+
+int pass = 0;
+int fail = 0;
+
+void check(std::string name, bool ok)
+{
+	ok ? pass++ : fail++;
+	printf("%-10s %s\n", name.c_str(), ok ? "PASS" : "FAIL");
+}
+
+// Values near every varint length, both signs and a few awkward reals
+bool codec(std::string filename)
+{
+	std::vector<uint64_t> nat = {0, 1, 127, 128, 16383, 16384,
+		(1ULL << 32) - 1, 1ULL << 32, (uint64_t)-1};
+	std::vector<int64_t> sign = {0, -1, 1, -64, 64, INT64_MIN, INT64_MAX};
+	std::vector<double> real = {0.0, -0.0, 1.0 / 3.0, -1e300, INFINITY};
+	std::vector<uint32_t> ids = {5, 3, 3, 0, 4000000000u, 7};
+	std::set<uint32_t> idset = {0, 2, 9, 100000};
+	std::vector<Vertex> vert = {{0.0,0.0}, {16.0,9.0}, {-3.25,7.5},
+		{1.0 / 3.0, -2.0 / 7.0}, {1e6, -1e6}};
+	std::map<uint32_t,uint32_t> idmap = {{1, 40}, {2, 0}, {90, 7}};
+	std::map<uint32_t,std::set<uint32_t>> rel = {{0, {}}, {3, {1, 4}}};
+	ckpt::Section a = {ckpt::SECTION::WORKSPACE, 0, {}};
+	for(auto x : nat) { a.data.varint(x); a.data.fixed(x); }
+	for(auto x : sign) { a.data.zigzag(x); }
+	for(auto x : real) { a.data.real(x); }
+	a.data.string("");
+	a.data.string("symmetry");
+	a.data.ids(ids);
+	a.data.idset(idset);
+	a.data.vertices(vert);
+	a.data.idmap(idmap);
+	a.data.relation(rel);
+	ckpt::Section b = {ckpt::SECTION::LAYER, 7, {}};
+	b.data.varint(42);
+	if(!ckpt::write(filename, {a, b})) { return false; }
+	ckpt::Map map(filename);
+	if(!map.good()) { return false; }
+	ckpt::Reader r = map.section(ckpt::SECTION::WORKSPACE, 0);
+	bool ok = true;
+	for(auto x : nat) { ok = ok && r.varint() == x && r.fixed() == x; }
+	for(auto x : sign) { ok = ok && r.zigzag() == x; }
+	for(auto x : real)
+	{
+		double y = r.real();
+		ok = ok && y == x && signbit(y) == signbit(x);
+	}
+	ok = ok && r.string() == "" && r.string() == "symmetry";
+	ok = ok && r.ids() == ids && r.idset() == idset;
+	// Coordinates come back on the grid
+	std::vector<Vertex> back = r.vertices();
+	ok = ok && back.size() == vert.size();
+	for(size_t i = 0; ok && i < vert.size(); i++)
+	{
+		double e = ldexp(1.0, -(int)ckpt::GRID);
+		ok = fabs(back[i].x - vert[i].x) <= e;
+		ok = ok && fabs(back[i].y - vert[i].y) <= e;
+	}
+	ok = ok && r.idmap() == idmap && r.relation() == rel && r.good();
+	// Reading past the end fails instead of running on
+	ok = ok && r.varint() == 0 && !r.good();
+	ckpt::Reader l = map.section(ckpt::SECTION::LAYER, 7);
+	ok = ok && l.varint() == 42 && l.good();
+	ok = ok && map.keys(ckpt::SECTION::LAYER) == std::vector<uint32_t>{7};
+	ok = ok && !map.section(ckpt::SECTION::LAYER, 8).good();
+	remove(filename.c_str());
+	return ok;
+}
+
+std::vector<uint8_t> bytes(std::string filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), {});
+}
+
+// A workspace laid out with focal points, so it has several layers
+Workspace* draft(out::Output* canvas, uint64_t seed)
+{
+	std::vector<Vertex> boundary = {
+		{0.0,0.0},
+		{16.0,0.0},
+		{16.0,9.0},
+		{0.0,9.0}};
+	Workspace* ws = new Workspace(canvas, boundary, 120.0, seed);
+	init_workspace(ws);
+	ws->addOperator(focal_point_operator);
+	return ws;
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 3;
+	printf("\nCHECKPOINT TEST: seed %llu\n", (unsigned long long)seed);
+	check("codec", codec("testcodec.ckpt"));
+	// Save part way through a layout, and load it into a workspace seeded
+	// differently, whose own state the load must replace
+	std::vector<out::Output*> canvas;
+	for(int i = 0; i < 4; i++)
+	{
+		canvas.push_back(new out::Output(out::BACKEND::RGBA, "", 960, 540));
+	}
+	Workspace* saved = draft(canvas[0], seed);
+	saved->runTempere(40, false);
+	bool ok = saved->saveLayout("testsaved.ckpt");
+	Workspace* loaded = draft(canvas[1], seed + 1);
+	ok = ok && loaded->loadLayout("testsaved.ckpt");
+	ok = ok && loaded->saveLayout("testloaded.ckpt");
+	ok = ok && bytes("testsaved.ckpt") == bytes("testloaded.ckpt");
+	ok = ok && loaded->cutSize() == saved->cutSize();
+	ok = ok && loaded->layers() == saved->layers();
+	check("resave", ok);
+	// The loaded layout draws the picture the saved one does
+	saved->render();
+	loaded->render();
+	ok = canvas[0]->rgba() == canvas[1]->rgba();
+	check("render", ok && saved->record()->size() == loaded->record()->size());
+	// Operator statistics start over on a load, so a resumed layout need not
+	// follow the run that saved it, but every resume follows the same course
+	Workspace* again = draft(canvas[2], seed + 2);
+	Workspace* other = draft(canvas[3], seed + 3);
+	ok = again->loadLayout("testsaved.ckpt");
+	ok = ok && other->loadLayout("testsaved.ckpt");
+	again->runTempere(70, false);
+	other->runTempere(70, false);
+	again->render();
+	other->render();
+	check("resume", ok && canvas[2]->rgba() == canvas[3]->rgba());
+	// A missing or truncated file leaves the workspace as it was
+	std::vector<uint8_t> data = bytes("testsaved.ckpt");
+	std::ofstream cut("testsaved.ckpt", std::ios::binary | std::ios::trunc);
+	cut.write((const char*)data.data(), data.size() / 2);
+	cut.close();
+	uint32_t cuts = loaded->cutSize();
+	ok = !loaded->loadLayout("testsaved.ckpt");
+	ok = ok && !loaded->loadLayout("testmissing.ckpt");
+	check("truncated", ok && loaded->cutSize() == cuts);
+	remove("testsaved.ckpt");
+	remove("testloaded.ckpt");
+	for(auto ws : {saved, loaded, again, other}) { delete ws; }
+	for(auto c : canvas) { delete c; }
+	printf("SUMMARY: %d tests, %d pass %d fail\n", pass + fail, pass, fail);
+	return fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// C imports
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+#include <thread>
+
+// Module imports
+#include "../cow.h"
+
+int pass = 0;
+int fail = 0;
+
+void check(std::string name, bool ok)
+{
+	ok ? pass++ : fail++;
+	printf("%-10s %s\n", name.c_str(), ok ? "PASS" : "FAIL");
+}
+
+std::vector<int> count(int first, int n)
+{
+	std::vector<int> ret;
+	for(int i = 0; i < n; i++) { ret.push_back(first + i); }
+	return ret;
+}
+
+// The chunks hold exactly the values, read singly or flattened
+bool holds(const cow::Chunks<int, 8>& c, const std::vector<int>& want)
+{
+	if(c.size() != want.size() || c.flat() != want) { return false; }
+	for(size_t i = 0; i < want.size(); i++)
+	{
+		if(c[i] != want[i]) { return false; }
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int n = argc > 1 ? atoi(argv[1]) : 100;
+	printf("COW TEST: %d values in chunks of 8\n", n);
+	// A sole holder writes in place, a shared value is copied first
+	cow::Cow<std::vector<int>> a(count(0, n));
+	const int* before = a->data();
+	a.edit()[0] = -1;
+	bool ok = a->data() == before;
+	cow::Cow<std::vector<int>> b = a;
+	b.edit()[1] = -2;
+	ok = ok && (*a)[1] == 1 && (*b)[1] == -2 && (*b)[0] == -1;
+	// After a fork neither side owns the data, so the original copies too
+	cow::Cow<std::vector<int>> c = a;
+	a.edit()[2] = -3;
+	ok = ok && (*c)[2] == 2 && (*a)[2] == -3;
+	check("cow", ok);
+	// Values round trip, over a chunk boundary and a partial last chunk
+	std::vector<int> vals = count(0, n);
+	cow::Chunks<int, 8> chunks(vals);
+	check("roundtrip", holds(chunks, vals) && holds(cow::Chunks<int, 8>(), {}));
+	// Appending to a copy leaves the original as it was, and the other way
+	cow::Chunks<int, 8> fork = chunks;
+	std::vector<int> more = vals;
+	for(int i = 0; i < 20; i++)
+	{
+		fork.push_back(1000 + i);
+		more.push_back(1000 + i);
+	}
+	ok = holds(fork, more) && holds(chunks, vals);
+	chunks.push_back(-1);
+	vals.push_back(-1);
+	check("fork", ok && holds(chunks, vals) && holds(fork, more));
+	// Forks appended on many threads at once each keep only their own
+	std::vector<cow::Chunks<int, 8>> forks(8, chunks);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 8; t++)
+	{
+		threads.emplace_back([&, t]() {
+			for(int i = 0; i < n; i++) { forks[t].push_back(t); }
+		});
+	}
+	for(auto& t : threads) { t.join(); }
+	ok = holds(chunks, vals);
+	for(int t = 0; t < 8; t++)
+	{
+		std::vector<int> want = vals;
+		want.insert(want.end(), n, t);
+		ok = ok && holds(forks[t], want);
+	}
+	check("threads", ok);
+	printf("SUMMARY: %d tests, %d pass %d fail\n", pass + fail, pass, fail);
+	return fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// C imports
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+// Module imports
+#include "../distribution.h"
+
+using dst::DIST;
+
+// The two sample Kolmogorov-Smirnov distance, ties stepped over together
+double ks(std::vector<double> a, std::vector<double> b)
+{
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	double d = 0.0;
+	size_t i = 0;
+	size_t j = 0;
+	while(i < a.size() && j < b.size())
+	{
+		double v = std::min(a[i], b[j]);
+		while(i < a.size() && a[i] == v) { i++; }
+		while(j < b.size() && b[j] == v) { j++; }
+		d = std::max(d, fabs(1.0 * i / a.size() - 1.0 * j / b.size()));
+	}
+	return d;
+}
+
+double mean(const std::vector<double>& s)
+{
+	double sum = 0.0;
+	for(auto x : s) { sum += x; }
+	return sum / s.size();
+}
+
+double deviation(const std::vector<double>& s)
+{
+	double m = mean(s);
+	double sum = 0.0;
+	for(auto x : s) { sum += (x - m) * (x - m); }
+	return sqrt(sum / s.size());
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 1 << 20;
+	std::vector<std::pair<std::string,DIST>> dists =
+	{
+		{"gaussian", DIST::GAUSSIAN},
+		{"bimodal", DIST::BIMODAL},
+		{"uniform", DIST::UNIFORM},
+		{"ddelta", DIST::DDELTA}
+	};
+	// Distances past this are a chance of 1 in 1000 for equal distributions
+	double critical = 1.949 * sqrt(2.0 / n);
+	int pass = 0;
+	int fail = 0;
+	printf("DISTRIBUTION TEST: %u samples, KS critical %f\n", n, critical);
+	for(auto & [name,type] : dists)
+	{
+		std::vector<double> scalar(n);
+		std::vector<double> block(n);
+		rng::Random rs(1);
+		rng::Random rb(2);
+		auto start = std::chrono::steady_clock::now();
+		for(uint32_t i = 0; i < n; i++)
+		{
+			scalar[i] = dst::continuous_sample(type, rs);
+		}
+		auto mid = std::chrono::steady_clock::now();
+		dst::continuous_block(type, rb, block.data(), n);
+		auto end = std::chrono::steady_clock::now();
+		std::chrono::duration<double> ts = mid - start;
+		std::chrono::duration<double> tb = end - mid;
+		// Block samples stay in range and match the scalar distribution
+		bool range = true;
+		for(auto x : block) { range = range && x >= 0.0 && x <= 1.0; }
+		double d = ks(scalar, block);
+		bool ok = range && d < critical;
+		ok ? pass++ : fail++;
+		printf("%-8s %s mean %f/%f sd %f/%f KS %f, %.1f/%.1f Msamples/s\n",
+			name.c_str(), ok ? "PASS" : "FAIL",
+			mean(scalar), mean(block), deviation(scalar), deviation(block), d,
+			n / ts.count() / 1e6, n / tb.count() / 1e6);
+	}
+	// A partial last block only fills what was asked for
+	std::vector<double> edge(11, -1.0);
+	rng::Random re(3);
+	dst::continuous_block(DIST::GAUSSIAN, re, edge.data(), 10);
+	bool ok = edge[9] >= 0.0 && edge[10] == -1.0;
+	ok ? pass++ : fail++;
+	printf("partial  %s\n", ok ? "PASS" : "FAIL");
+	printf("SUMMARY: %d tests, %d pass %d fail\n", pass + fail, pass, fail);
+	return fail == 0 ? 0 : 1;
+}
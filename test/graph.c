@@ -0,0 +1,216 @@
+// C imports
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+
+// Module imports
+#include "../graph.h"
+#include "../random.h"
+
+typedef std::vector<std::vector<bool>> Matrix;
+
+int pass = 0;
+int fail = 0;
+
+void check(std::string name, bool ok)
+{
+	ok ? pass++ : fail++;
+	printf("%-12s %s\n", name.c_str(), ok ? "PASS" : "FAIL");
+}
+
+// Link weights are symmetric, as the graph is undirected
+double weight(uint32_t u, uint32_t v) { return 1.0 + (u * v) % 7; }
+
+// Random links between n nodes, with repeats, reversals and self links
+std::vector<graph::Link> links(uint32_t n, uint32_t count, rng::Random& r)
+{
+	std::vector<graph::Link> ret;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		uint32_t a = r() * n;
+		uint32_t b = r() * n;
+		ret.push_back({a, b});
+		if(r() < 0.1) { ret.push_back({b, a}); }
+	}
+	return ret;
+}
+
+// The same graph as a matrix, to check the CSR against
+Matrix matrix(uint32_t n, const std::vector<graph::Link>& link)
+{
+	Matrix ret(n, std::vector<bool>(n, false));
+	for(auto [a,b] : link)
+	{
+		if(a == b) { continue; }
+		ret[a][b] = true;
+		ret[b][a] = true;
+	}
+	return ret;
+}
+
+bool rows(const graph::CSR& g, const Matrix& m)
+{
+	uint32_t n = m.size();
+	if(graph::nodes(g) != n) { return false; }
+	for(uint32_t a = 0; a < n; a++)
+	{
+		std::vector<uint32_t> want;
+		for(uint32_t b = 0; b < n; b++) { if(m[a][b]) { want.push_back(b); } }
+		std::vector<uint32_t> got;
+		for(auto b : graph::neighbours(g, a)) { got.push_back(b); }
+		if(got != want) { return false; }
+		for(uint32_t b = 0; b < n; b++)
+		{
+			if(graph::linked(g, a, b) != m[a][b]) { return false; }
+		}
+	}
+	// Bases offset ids, and nodes past the end have no neighbours
+	graph::Range far = graph::neighbours(g, 0, 100);
+	for(uint32_t i = 0; i < far.size(); i++)
+	{
+		if(far[i] != graph::neighbours(g, 0)[i] + 100) { return false; }
+	}
+	return graph::neighbours(g, n).size() == 0 && !graph::linked(g, n, 0);
+}
+
+// Distances by relaxing every link until nothing changes
+std::vector<double> relax(const Matrix& m,
+	const std::vector<uint32_t>& sources, bool hops)
+{
+	uint32_t n = m.size();
+	std::vector<double> ret(n, INFINITY);
+	for(auto s : sources) { ret[s] = 0.0; }
+	for(bool changed = true; changed;)
+	{
+		changed = false;
+		for(uint32_t u = 0; u < n; u++)
+		{
+			for(uint32_t v = 0; v < n; v++)
+			{
+				if(!m[u][v]) { continue; }
+				double d = ret[u] + (hops ? 1.0 : weight(u, v));
+				if(d < ret[v]) { ret[v] = d; changed = true; }
+			}
+		}
+	}
+	return ret;
+}
+
+// The tree agrees with the distances, and each parent is one link closer
+bool tree(const graph::Tree& t, const Matrix& m,
+	const std::vector<double>& want, bool hops)
+{
+	uint32_t reached = 0;
+	for(uint32_t v = 0; v < m.size(); v++)
+	{
+		if(isinf(want[v]))
+		{
+			if(t.root[v] != graph::NONE || !isinf(t.dist[v])) { return false; }
+			continue;
+		}
+		reached++;
+		if(fabs(t.dist[v] - want[v]) > 1e-9) { return false; }
+		uint32_t p = t.parent[v];
+		if(p == graph::NONE)
+		{
+			if(t.dist[v] != 0.0 || t.root[v] != v) { return false; }
+			continue;
+		}
+		double step = hops ? 1.0 : weight(p, v);
+		if(!m[p][v] || fabs(t.dist[p] + step - t.dist[v]) > 1e-9)
+		{
+			return false;
+		}
+		if(t.root[v] != t.root[p]) { return false; }
+	}
+	// Every reached node is in the order once, nearest first
+	if(t.order.size() != reached) { return false; }
+	for(uint32_t i = 1; i < t.order.size(); i++)
+	{
+		if(t.dist[t.order[i]] < t.dist[t.order[i-1]]) { return false; }
+	}
+	return true;
+}
+
+// Join random pairs and keep plain labels alongside, relabelling every node
+// on the side of b at each join. Some nodes are grown in after the start.
+bool groups(uint32_t n, uint32_t joins, rng::Random& r)
+{
+	graph::Groups g(n / 2);
+	g.grow(n);
+	std::vector<uint32_t> label(n);
+	for(uint32_t i = 0; i < n; i++) { label[i] = i; }
+	for(uint32_t i = 0; i < joins; i++)
+	{
+		uint32_t a = r() * n;
+		uint32_t b = r() * n;
+		bool apart = label[a] != label[b];
+		if(g.join(a, b) != apart) { return false; }
+		uint32_t from = label[b];
+		for(auto& l : label) { if(l == from) { l = label[a]; } }
+	}
+	for(uint32_t a = 0; a < n; a++)
+	{
+		// Members are the whole group, each once, starting from the node
+		auto mem = g.members(a);
+		std::vector<bool> in(n, false);
+		for(auto v : mem)
+		{
+			if(in[v] || label[v] != label[a]) { return false; }
+			in[v] = true;
+		}
+		uint32_t size = 0;
+		for(auto l : label) { if(l == label[a]) { size++; } }
+		if(mem[0] != a || mem.size() != size || g.size(a) != size)
+		{
+			return false;
+		}
+		if(label[g.find(a)] != label[a]) { return false; }
+		for(uint32_t b = 0; b < n; b++)
+		{
+			if(g.same(a, b) != (label[a] == label[b])) { return false; }
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+	rng::Random r(seed);
+	// Sparse enough to leave several components
+	uint32_t n = 120;
+	auto link = links(n, 100, r);
+	Matrix m = matrix(n, link);
+	graph::CSR g = graph::build(n, link);
+	printf("GRAPH TEST: %u nodes, %zu links, seed %llu\n",
+		n, link.size(), (unsigned long long)seed);
+	check("csr", rows(g, m));
+	check("bfs", tree(graph::bfs(g, 0), m, relax(m, {0}, true), true));
+	std::vector<uint32_t> sources = {3, 40, 77};
+	check("dijkstra",
+		tree(graph::dijkstra(g, sources, weight), m,
+			relax(m, sources, false), false));
+	// Components label nodes the same exactly when a search links them
+	uint32_t count = 0;
+	auto label = graph::components(g, count);
+	bool ok = true;
+	uint32_t seen = 0;
+	for(uint32_t s = 0; s < n; s++)
+	{
+		auto d = relax(m, {s}, true);
+		if(label[s] == seen) { seen++; }
+		for(uint32_t v = 0; v < n; v++)
+		{
+			ok = ok && (label[v] == label[s]) == !isinf(d[v]);
+		}
+	}
+	check("components", ok && seen == count);
+	check("groups", groups(n, 90, r));
+	printf("SUMMARY: %d tests, %d pass %d fail\n", pass + fail, pass, fail);
+	return fail == 0 ? 0 : 1;
+}
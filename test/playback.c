@@ -0,0 +1,90 @@
+// C imports
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+#include <string>
+
+// Module imports
+#include "../render.h"
+#include "../output.h"
+#include "../operators.h"
+
+typedef struct picture
+{
+	uint32_t layers;
+	std::vector<uint8_t> pixels;
+} Picture;
+
+// Lay out and render one picture, played on the given number of workers
+Picture play(uint64_t seed, uint32_t workers)
+{
+	std::vector<Vertex> boundary = {
+		{0.0,0.0},
+		{16.0,0.0},
+		{16.0,9.0},
+		{0.0,9.0}};
+	out::Output* canvas = new out::Output(out::BACKEND::RGBA, "", 1920, 1080);
+	Workspace* ws = new Workspace(canvas, boundary, 120.0, seed);
+	init_workspace(ws);
+	// The default operators keep to one layer, focal points bounce up
+	ws->addOperator(focal_point_operator);
+	ws->runTempere(110, false);
+	ws->setWorkers(workers);
+	ws->render();
+	Picture ret {ws->layers(), canvas->rgba()};
+	delete ws;
+	delete canvas;
+	return ret;
+}
+
+// Compare two pictures, every way of playing must draw the same pixels
+bool same(std::string name, const Picture& want, const Picture& got)
+{
+	if(want.pixels.size() != got.pixels.size())
+	{
+		printf("FAIL %s: %zu bytes, expected %zu\n",
+			name.c_str(), got.pixels.size(), want.pixels.size());
+		return false;
+	}
+	int worst = 0;
+	size_t differ = 0;
+	for(size_t i = 0; i < want.pixels.size(); i += 4)
+	{
+		int diff = 0;
+		for(size_t c = 0; c < 4; c++)
+		{
+			int d = abs((int)want.pixels[i+c] - (int)got.pixels[i+c]);
+			if(d > diff) { diff = d; }
+		}
+		if(diff > 0) { differ++; }
+		if(diff > worst) { worst = diff; }
+	}
+	bool pass = worst == 0;
+	printf("%s %s: %zu pixels differ, worst channel by %d\n",
+		pass ? "PASS" : "FAIL", name.c_str(), differ, worst);
+	return pass;
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 3;
+	printf("\nPLAYBACK TEST: seed %llu\n", (unsigned long long)seed);
+	// One worker plays the whole record in order, the reference picture
+	Picture record = play(seed, 1);
+	if(record.layers < 2)
+	{
+		printf("FAIL: seed %llu lays out %u layers, need two or more\n",
+			(unsigned long long)seed, record.layers);
+		return 1;
+	}
+	// As many workers as layers plays the layers, one more plays tiles
+	Picture layers = play(seed, record.layers);
+	Picture tiles = play(seed, record.layers + 1);
+	int fail = 0;
+	if(!same("layers", record, layers)) { fail++; }
+	if(!same("tiles", record, tiles)) { fail++; }
+	printf("SUMMARY: %d of 2 failed\n", fail);
+	return fail == 0 ? 0 : 1;
+}
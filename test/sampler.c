@@ -0,0 +1,61 @@
+// C imports
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ imports
+#include <vector>
+
+// Module imports
+#include "../sampler.h"
+
+// Draw on an even grid of picks and compare how often each index comes up to
+// its share of the weights above d. The grid makes the counts exact to one.
+bool frequencies(smp::Weighted& w, const std::vector<double>& weight,
+	const std::vector<bool>& usable, double d, uint32_t n)
+{
+	std::vector<uint32_t> count(weight.size(), 0);
+	uint32_t none = 0;
+	for(uint32_t k = 0; k < n; k++)
+	{
+		int64_t i = w.draw(d, (k + 0.5) / n);
+		if(i < 0) { none++; }
+		else { count[i]++; }
+	}
+	double total = 0.0;
+	for(uint32_t i = 0; i < weight.size(); i++)
+	{
+		if(usable[i] && weight[i] > d) { total += weight[i]; }
+	}
+	bool ok = total > 0.0 ? none == 0 : none == n;
+	for(uint32_t i = 0; i < weight.size(); i++)
+	{
+		bool in = usable[i] && weight[i] > d;
+		double want = in ? n * weight[i] / total : 0.0;
+		ok = ok && fabs(count[i] - want) <= 1.0;
+	}
+	printf("threshold %5.2f %s:", d, ok ? "PASS" : "FAIL");
+	for(auto c : count) { printf(" %u", c); }
+	printf("%s\n", none > 0 ? " none drawn" : "");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t n = argc > 1 ? atoi(argv[1]) : 100000;
+	std::vector<double> weight = {1.0, 2.0, 3.0, 0.0, 4.0, 5.0, 0.5, 2.0};
+	std::vector<bool> usable =
+		{true, true, false, true, true, true, true, true};
+	smp::Weighted w(weight, usable);
+	printf("SAMPLER TEST: %zu weights, %u draws each\n", weight.size(), n);
+	// Thresholds fall to add weights and rise to rebuild without them
+	std::vector<double> threshold = {4.5, 2.5, 0.75, -1.0, 3.0, 1.5, 6.0, 0.0};
+	int pass = 0;
+	int fail = 0;
+	for(auto d : threshold)
+	{
+		frequencies(w, weight, usable, d, n) ? pass++ : fail++;
+	}
+	printf("SUMMARY: %d tests, %d pass %d fail\n", pass + fail, pass, fail);
+	return fail == 0 ? 0 : 1;
+}